@@ -7,270 +7,3066 @@
  * Implementation of the debugSerial library for ATmega328PB using UART1.
  * Uses a ring buffer for buffered serial transmission (transmit-only).
  *
- * For ATmega328P:
- * - Replace UART1 registers (UBRR1H, UBRR1L, UCSR1A, UCSR1B, UCSR1C, UDR1, USART1_UDRE_vect)
- *   with UART0 registers (UBRR0H, UBRR0L, UCSR0A, UCSR0B, UCSR0C, UDR0, USART_UDRE_vect).
- * - See README.md for details.
+ * The transmitter is written once against the debugUsart<N> port traits (debugUsart.h)
+ * and instantiated per channel (text, telemetry, fault), each with its own ring buffer
+ * and USART. Other USARTs and parts (ATmega328P, ATmega2560) need no source edits,
+ * see README.md.
  */
 
+#if !defined(__cplusplus)
+#error "debugSerial.cpp is C++ (C++98 or newer): compile it with avr-g++, not as C."
+#endif
+
 #include "debugSerial.h"
+#include "debugUsart.h"
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/crc16.h>
+#include <util/delay_basic.h>
+#include <string.h>
+#include <math.h>
+
+// Compiler barrier: keeps the buffer stores ahead of the index store that publishes
+// them. A single-core AVR needs no hardware fence.
+#define DEBUG_MEMORY_BARRIER() __asm__ __volatile__("" ::: "memory")
+
+// Interrupt-state-preserving critical section: saves SREG and masks interrupts for the
+// lifetime of the object, then restores SREG (ATOMIC_RESTORESTATE semantics), so it
+// never enables interrupts the caller had disabled and may nest. Empty without
+// DEBUG_ISR_SAFE. Costs 3 cycles on entry and 1 on exit besides holding the register.
+struct debugCritical {
+#if DEBUG_ISR_SAFE
+    uint8_t sreg;
+    debugCritical() : sreg(SREG) {
+        cli();
+    }
+    ~debugCritical() {
+        DEBUG_MEMORY_BARRIER();
+        SREG = sreg;
+    }
+#else
+    debugCritical() {
+    }
+#endif
+};
+
+// Channels enabled on each USART, usable in #if and in templates on the port number
+#define DEBUG_TEXT_ON(n) (DEBUG_USART == (n))
+#if DEBUG_TELEMETRY_BUFFER_SIZE > 0
+#define DEBUG_TELEMETRY_ON(n) (DEBUG_TELEMETRY_USART == (n))
+#define DEBUG_TELEMETRY_CHANNEL DEBUG_CHANNEL_TELEMETRY
+#else
+#define DEBUG_TELEMETRY_ON(n) 0
+#define DEBUG_TELEMETRY_CHANNEL DEBUG_CHANNEL_TEXT     // Records share the text buffer
+#endif
+#if DEBUG_FAULT_BUFFER_SIZE > 0
+#define DEBUG_FAULT_ON(n) (DEBUG_FAULT_USART == (n))
+#else
+#define DEBUG_FAULT_ON(n) 0
+#endif
+#define DEBUG_PORT_USED(n) (DEBUG_TEXT_ON(n) || DEBUG_TELEMETRY_ON(n) || DEBUG_FAULT_ON(n))
+#define DEBUG_PORT_SHARED(n) ((DEBUG_TEXT_ON(n) + DEBUG_TELEMETRY_ON(n) + DEBUG_FAULT_ON(n)) > 1)
+
+// No port owns the transmitter between messages
+#define DEBUG_CHANNEL_NONE 0xFF
+
+#if DEBUG_PORT_USED(0) && !defined(UDR0)
+#error "A debug channel selects USART0, which this part does not have."
+#endif
+#if DEBUG_PORT_USED(1) && !defined(UDR1)
+#error "A debug channel selects USART1, which this part does not have."
+#endif
+#if DEBUG_PORT_USED(2) && !defined(UDR2)
+#error "A debug channel selects USART2, which this part does not have."
+#endif
+#if DEBUG_PORT_USED(3) && !defined(UDR3)
+#error "A debug channel selects USART3, which this part does not have."
+#endif
+
+// Ring buffer of Size bytes (a power of two up to 256), one per channel
+// debugTail is written only by the port's UDRE interrupt and debugHead only by the
+// producers. With DEBUG_ISR_SAFE the producers (main loop and other ISRs) update it
+// inside a debugCritical section; otherwise the main context is the only producer and
+// neither side needs to disable interrupts.
+template <uint16_t Size>
+struct debugRing {
+    char debugBuffer[Size];
+    volatile uint8_t debugHead;
+    volatile uint8_t debugTail;
+};
+
+// Channel configuration: USART and ring buffer size. Every channel's messages end at a
+// line end ('\n') or at the end of a binary record (debug_channel_boundary), where a
+// higher-priority channel on the same USART may take over.
+template <uint8_t C>
+struct debugChannelConfig;
+
+template <>
+struct debugChannelConfig<DEBUG_CHANNEL_TEXT> {
+    enum { usart = DEBUG_USART, size = DEBUG_BUFFER_SIZE };
+};
+#if DEBUG_TELEMETRY_BUFFER_SIZE > 0
+template <>
+struct debugChannelConfig<DEBUG_CHANNEL_TELEMETRY> {
+    enum { usart = DEBUG_TELEMETRY_USART, size = DEBUG_TELEMETRY_BUFFER_SIZE };
+};
+#endif
+#if DEBUG_FAULT_BUFFER_SIZE > 0
+template <>
+struct debugChannelConfig<DEBUG_CHANNEL_FAULT> {
+    enum { usart = DEBUG_FAULT_USART, size = DEBUG_FAULT_BUFFER_SIZE };
+};
+#endif
+
+// Per-channel transmitter state, instantiated only for the channels the build enables
+template <uint8_t C>
+struct debugChannel : debugChannelConfig<C> {
+    typedef debugChannelConfig<C> config;
+    enum {
+        mask = config::size - 1,
+        usable = config::size - 1,                                  // One slot stays free
+        frameMax = config::size - 1 - DEBUG_FRAME_OVERHEAD          // Data per frame
+    };
+    static debugRing<config::size> buffer;
+#if DEBUG_FRAMING
+    static uint8_t frameSeq;
+#endif
+#if DEBUG_STATS
+    static debugStats_t stats;
+#endif
+#if (DEBUG_OVERFLOW_POLICY == DEBUG_OVERFLOW_MARK) && !DEBUG_FRAMING
+    static uint16_t droppedBytes;
+#endif
+#if DEBUG_TIMESTAMP
+    static bool lineStart;      // The next text byte starts a line and gets a stamp
+#endif
+#if !DEBUG_FRAMING
+    static uint8_t recordState; // Binary record the ISR is in (debug_channel_boundary)
+    static uint8_t recordLeft;
+#endif
+};
+
+template <uint8_t C>
+debugRing<debugChannelConfig<C>::size> debugChannel<C>::buffer;
+#if DEBUG_FRAMING
+template <uint8_t C>
+uint8_t debugChannel<C>::frameSeq;
+#endif
+#if DEBUG_STATS
+template <uint8_t C>
+debugStats_t debugChannel<C>::stats;
+#endif
+#if (DEBUG_OVERFLOW_POLICY == DEBUG_OVERFLOW_MARK) && !DEBUG_FRAMING
+template <uint8_t C>
+uint16_t debugChannel<C>::droppedBytes;
+#endif
+#if DEBUG_TIMESTAMP
+template <uint8_t C>
+bool debugChannel<C>::lineStart;
+#endif
+#if !DEBUG_FRAMING
+template <uint8_t C>
+uint8_t debugChannel<C>::recordState;
+template <uint8_t C>
+uint8_t debugChannel<C>::recordLeft;
+#endif
+
+// Per-USART state: the channel whose message is on the wire, when several channels
+// share the USART, whether a byte was sent since debugSerialBegin (TXCn is only
+// meaningful after the first one), and the UDRE interrupt count for DEBUG_STATS
+template <uint8_t N>
+struct debugPort {
+    static uint8_t owner;
+    static volatile bool active;
+#if DEBUG_STATS
+    static uint32_t interrupts;
+#endif
+};
+
+template <uint8_t N>
+uint8_t debugPort<N>::owner = DEBUG_CHANNEL_NONE;
+template <uint8_t N>
+volatile bool debugPort<N>::active;
+#if DEBUG_STATS
+template <uint8_t N>
+uint32_t debugPort<N>::interrupts;
+#endif
 
-static debugRingBuffer_t debugTxBuffer;
+// Channel the text output (print functions, debugLog, token records) goes to
+#if (DEBUG_TELEMETRY_BUFFER_SIZE > 0) || (DEBUG_FAULT_BUFFER_SIZE > 0)
+static uint8_t debugSelectedChannel = DEBUG_CHANNEL_TEXT;
+#endif
+
+// Set by debugPanicBegin: output bypasses the UDRE interrupt and is sent by polling
+static bool debugPanicMode;
+
+// Timer1 runs free in normal mode for DEBUG_PROFILE and for timestamps without a
+// DEBUG_TIMESTAMP_SOURCE, at the timestamp prescaler (1 when profiling)
+#if DEBUG_PROFILE || (DEBUG_TIMESTAMP && !defined(DEBUG_TIMESTAMP_SOURCE))
+#define DEBUG_TIMER1_USED 1
+#if !defined(TCNT1)
+#error "DEBUG_PROFILE and DEBUG_TIMESTAMP need Timer/Counter1 (or a DEBUG_TIMESTAMP_SOURCE)."
+#endif
+#if DEBUG_PROFILE || (DEBUG_TIMESTAMP_PRESCALER == 1)
+#define DEBUG_TIMER1_CLOCK (1 << CS10)
+#elif DEBUG_TIMESTAMP_PRESCALER == 8
+#define DEBUG_TIMER1_CLOCK (1 << CS11)
+#elif DEBUG_TIMESTAMP_PRESCALER == 64
+#define DEBUG_TIMER1_CLOCK ((1 << CS11) | (1 << CS10))
+#elif DEBUG_TIMESTAMP_PRESCALER == 256
+#define DEBUG_TIMER1_CLOCK (1 << CS12)
+#else
+#define DEBUG_TIMER1_CLOCK ((1 << CS12) | (1 << CS10))
+#endif
+#else
+#define DEBUG_TIMER1_USED 0
+#endif
+
+#if DEBUG_TIMESTAMP && !defined(DEBUG_TIMESTAMP_SOURCE)
+// Upper 16 bits of the timestamp clock, counted by TIMER1_OVF_vect
+static volatile uint16_t debugTimestampHigh;
+#elif DEBUG_TIMESTAMP
+extern "C" uint32_t DEBUG_TIMESTAMP_SOURCE(void);
+#endif
+
+#if DEBUG_PROFILE
+
+// Profile table, the library call nesting depth (only the outermost call is timed) and
+// the cycles a timestamp pair costs, measured by debugProfileReset
+static debugProfile_t debugProfileTable[DEBUG_PROFILE_SLOTS];
+static uint8_t debugProfileDepth;
+static uint16_t debugProfileOverhead;
 
 // -----------------------------------------------------------------------------------
-// Ring buffer initialization procedure
+// Profile timestamp procedure (DEBUG_PROFILE)
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: uint16_t - TCNT1, in CPU cycles modulo 65536
+// The 16-bit read goes through the TEMP latch shared by all Timer1 registers, so it
+// runs with interrupts masked: an ISR reading TCNT1 between the two byte reads would
+// otherwise hand back its own high byte.
+// -----------------------------------------------------------------------------------
+static inline uint16_t debug_profile_now(void) {
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t now = TCNT1;
+    SREG = sreg;
+    return now;
+}
+
+// -----------------------------------------------------------------------------------
+// Profile record procedure (DEBUG_PROFILE)
 // -----------------------------------------------------------------------------------
-// Input : debugRingBuffer_t *buf - Pointer to the ring buffer structure to initialize
+// Input : uint8_t slot - Profile slot, or DEBUG_PROFILE_SLOTS to calibrate
+// Input : uint16_t cycles - Measured duration including the timestamp cost
 // Output: void
-// Initializes the ring buffer by setting the head and tail indices to zero,
-// preparing it for data storage and retrieval.
+// Subtracts the timestamp cost and adds the call to the slot, with interrupts masked
+// so a call timed in an ISR cannot tear the update.
 // -----------------------------------------------------------------------------------
-static void debug_buffer_init(debugRingBuffer_t *buf) {
-    buf->debugHead = 0;
-    buf->debugTail = 0;
+static void debug_profile_record(uint8_t slot, uint16_t cycles) {
+    uint8_t sreg = SREG;
+    cli();
+    if (slot >= DEBUG_PROFILE_SLOTS) {
+        debugProfileOverhead = cycles;
+    } else {
+        debugProfile_t *entry = &debugProfileTable[slot];
+        cycles = (cycles > debugProfileOverhead) ? (uint16_t)(cycles - debugProfileOverhead) : 0;
+        entry->calls++;
+        entry->total += cycles;
+        if (cycles < entry->min) {
+            entry->min = cycles;
+        }
+        if (cycles > entry->max) {
+            entry->max = cycles;
+        }
+    }
+    SREG = sreg;
 }
 
+// Times the enclosing library call for its lifetime, unless it runs inside another
+// timed call. An ISR printing while the main loop is inside a call leaves the depth as
+// it found it, and shows up in that call's max instead of its own slot.
+struct debugProfileScope {
+    uint8_t slot;
+    uint16_t start;
+    explicit debugProfileScope(uint8_t s) : slot(s), start(0) {
+        if (debugProfileDepth++ == 0) {
+            start = debug_profile_now();
+        }
+    }
+    ~debugProfileScope() {
+        if (--debugProfileDepth == 0) {
+            debug_profile_record(slot, (uint16_t)(debug_profile_now() - start));
+        }
+    }
+};
+
+// Times a UDRE interrupt handler. Interrupts do not nest, so no depth check is needed,
+// and the handler is timed even while it interrupts a timed call. The vector jump,
+// register saves and RETI around the body are not included.
+struct debugProfileInterrupt {
+    uint16_t start;
+    debugProfileInterrupt() : start(debug_profile_now()) {
+    }
+    ~debugProfileInterrupt() {
+        debug_profile_record(DEBUG_PROFILE_ISR, (uint16_t)(debug_profile_now() - start));
+    }
+};
+
+#define DEBUG_PROFILE_SCOPE(slot) debugProfileScope debugProfileCall(slot)
+#define DEBUG_PROFILE_INTERRUPT() debugProfileInterrupt debugProfileCall
+#else
+#define DEBUG_PROFILE_SCOPE(slot)
+#define DEBUG_PROFILE_INTERRUPT()
+#endif
+
+// Formatting tables live in flash (PROGMEM) and are read with pgm_read_*, so they cost
+// no SRAM.
+
+// Powers of ten used by the subtraction-based digit engine (10^9 down to 10^1)
+static const uint32_t debugPow10[9] PROGMEM = {
+    1000000000UL, 100000000UL, 10000000UL, 1000000UL, 100000UL,
+    10000UL, 1000UL, 100UL, 10UL
+};
+
+// Powers of ten for the upper digits of 64-bit values (10^19 down to 10^9)
+static const uint64_t debugPow10Wide[11] PROGMEM = {
+    10000000000000000000ULL, 1000000000000000000ULL, 100000000000000000ULL,
+    10000000000000000ULL, 1000000000000000ULL, 100000000000000ULL,
+    10000000000000ULL, 1000000000000ULL, 100000000000ULL,
+    10000000000ULL, 1000000000ULL
+};
+
+// Float scale factors for debugPrintFloat (10^0 up to 10^DEBUG_FLOAT_MAX_DECIMALS)
+static const float debugFloatPow10[DEBUG_FLOAT_MAX_DECIMALS + 1] PROGMEM = {
+    1.0f, 10.0f, 100.0f, 1000.0f, 10000.0f,
+    100000.0f, 1000000.0f, 10000000.0f, 100000000.0f, 1000000000.0f
+};
+
+// Bits needed to hold 10^d (10^d < 2^bits), used to pick 32-bit fixed-point arithmetic
+static const uint8_t debugPow10Bits[DEBUG_FLOAT_MAX_DECIMALS + 1] PROGMEM = {
+    1, 4, 7, 10, 14, 17, 20, 24, 27, 30
+};
+
+// Nibble to hex digit lookup table
+static const char debugHexDigits[16] PROGMEM = {
+    '0', '1', '2', '3', '4', '5', '6', '7', '8', '9', 'A', 'B', 'C', 'D', 'E', 'F'
+};
+
 // -----------------------------------------------------------------------------------
-// Ring buffer empty check procedure
+// Hexadecimal formatting procedure
 // -----------------------------------------------------------------------------------
-// Input : debugRingBuffer_t *buf - Pointer to the ring buffer structure to check
-// Output: bool - Returns true if the buffer is empty, false otherwise
-// Checks if the ring buffer is empty by comparing the head and tail indices.
-// Returns true when head equals tail, indicating no data is queued.
+// Input : char *out - Destination for the digits (not terminated)
+// Input : uint32_t value - The value to format
+// Input : uint8_t digits - Number of hex digits to produce (1 to 8), zero-padded
+// Output: void
+// Writes the low digits * 4 bits of value as upper-case hex, most significant nibble
+// first, using the nibble lookup table (shift and mask only).
 // -----------------------------------------------------------------------------------
-static bool debug_buffer_is_empty(debugRingBuffer_t *buf) {
-    return (buf->debugHead == buf->debugTail);
+static void debug_format_hex(char *out, uint32_t value, uint8_t digits) {
+    while (digits > 0) {
+        out[--digits] = pgm_read_byte(&debugHexDigits[value & 0x0F]);
+        value >>= 4;
+    }
 }
 
 // -----------------------------------------------------------------------------------
-// Ring buffer full check procedure
+// Unsigned decimal formatting procedure
 // -----------------------------------------------------------------------------------
-// Input : debugRingBuffer_t *buf - Pointer to the ring buffer structure to check
-// Output: bool - Returns true if the buffer is full, false otherwise
-// Checks if the ring buffer is full by determining if the next head position
-// (head + 1, modulo buffer size) equals the tail, indicating no space for new data.
+// Input : char *out - Destination for the digits (at least 10 bytes, not terminated)
+// Input : uint32_t value - The value to format
+// Input : uint8_t minDigits - Minimum number of digits; shorter values get leading zeros
+// Output: uint8_t - Number of digits written
+// Produces the decimal digits most-significant first without any division: each digit
+// is found by repeatedly subtracting the matching power of ten (at most 9 compare and
+// subtract steps per digit). On AVR this avoids a __udivmodsi4 call per digit, which
+// costs several hundred cycles each. Leading zeros are suppressed; zero prints as "0".
 // -----------------------------------------------------------------------------------
-static bool debug_buffer_is_full(debugRingBuffer_t *buf) {
-    return ((buf->debugHead + 1) % DEBUG_BUFFER_SIZE) == buf->debugTail;
+static uint8_t debug_format_uint32(char *out, uint32_t value, uint8_t minDigits) {
+    uint8_t len = 0;
+    for (uint8_t i = 0; i < 9; i++) {
+        uint32_t power = pgm_read_dword(&debugPow10[i]);
+        char digit = '0';
+        while (value >= power) {
+            value -= power;
+            digit++;
+        }
+        if (digit != '0' || len > 0 || (uint8_t)(10 - i) <= minDigits) {
+            out[len++] = digit;
+        }
+    }
+    out[len++] = '0' + (char)value;
+    return len;
 }
 
 // -----------------------------------------------------------------------------------
-// Ring buffer data insertion procedure
+// 64-bit unsigned decimal formatting procedure
 // -----------------------------------------------------------------------------------
-// Input : debugRingBuffer_t *buf - Pointer to the ring buffer structure
-// Input : char data - The character to insert into the buffer
-// Output: void
-// Adds a character to the ring buffer at the head position if the buffer is not full,
-// then advances the head index (modulo buffer size). Ignores the data if the buffer is full.
+// Input : char *out - Destination for the digits (at least 20 bytes, not terminated)
+// Input : uint64_t value - The value to format
+// Output: uint8_t - Number of digits written
+// Values that fit in 32 bits go straight to debug_format_uint32. Larger values have
+// their upper digits (10^19 .. 10^9) peeled off with 64-bit subtractions; the remainder
+// is then below 10^9 and finished as exactly nine 32-bit digits.
 // -----------------------------------------------------------------------------------
-static void debug_buffer_put(debugRingBuffer_t *buf, char data) {
-    if (!debug_buffer_is_full(buf)) {
-        buf->debugBuffer[buf->debugHead] = data;
-        buf->debugHead = (buf->debugHead + 1) % DEBUG_BUFFER_SIZE;
+static uint8_t debug_format_uint64(char *out, uint64_t value) {
+    if ((value >> 32) == 0) {
+        return debug_format_uint32(out, (uint32_t)value, 1);
+    }
+    uint8_t len = 0;
+    for (uint8_t i = 0; i < 11; i++) {
+        uint64_t power;
+        memcpy_P(&power, &debugPow10Wide[i], sizeof(power));
+        char digit = '0';
+        while (value >= power) {
+            value -= power;
+            digit++;
+        }
+        if (digit != '0' || len > 0) {
+            out[len++] = digit;
+        }
     }
+    return len + debug_format_uint32(&out[len], (uint32_t)value, 9);
+}
+
+// -----------------------------------------------------------------------------------
+// Ring buffer initialization procedure
+// -----------------------------------------------------------------------------------
+// Input : debugRing<Size> *buf - Pointer to the ring buffer structure to initialize
+// Output: void
+// Initializes the ring buffer by setting the head and tail indices to zero,
+// preparing it for data storage and retrieval.
+// -----------------------------------------------------------------------------------
+template <uint16_t Size>
+static void debug_buffer_init(debugRing<Size> *buf) {
+    buf->debugHead = 0;
+    buf->debugTail = 0;
+}
+
+// -----------------------------------------------------------------------------------
+// Ring buffer free space procedure
+// -----------------------------------------------------------------------------------
+// Input : debugRing<Size> *buf - Pointer to the ring buffer structure
+// Output: uint8_t - Number of bytes that can be inserted without overwriting
+// Computes the gap between head and tail (masked to the buffer size), keeping one
+// slot free to distinguish a full buffer from an empty one.
+// -----------------------------------------------------------------------------------
+template <uint16_t Size>
+static inline uint8_t debug_buffer_space(debugRing<Size> *buf) {
+    return (uint8_t)((buf->debugTail - buf->debugHead - 1) & (Size - 1));
 }
 
 // -----------------------------------------------------------------------------------
 // Ring buffer data retrieval procedure
 // -----------------------------------------------------------------------------------
-// Input : debugRingBuffer_t *buf - Pointer to the ring buffer structure
+// Input : debugRing<Size> *buf - Pointer to the ring buffer structure
 // Input : char *data - Pointer to store the retrieved character
 // Output: bool - Returns true if a character was retrieved, false if the buffer is empty
 // Retrieves a character from the tail of the ring buffer, stores it in *data,
-// and advances the tail index (modulo buffer size). Returns false if the buffer is empty.
+// and advances the tail index (masked to the buffer size). Returns false if the buffer is empty.
+// Consumer side only: the character is read before the slot is released to the producer.
 // -----------------------------------------------------------------------------------
-static bool debug_buffer_get(debugRingBuffer_t *buf, char *data) {
-    if (!debug_buffer_is_empty(buf)) {
-        *data = buf->debugBuffer[buf->debugTail];
-        buf->debugTail = (buf->debugTail + 1) % DEBUG_BUFFER_SIZE;
+template <uint16_t Size>
+static inline bool debug_buffer_get(debugRing<Size> *buf, char *data) {
+    uint8_t tail = buf->debugTail;
+    if (tail != buf->debugHead) {
+        *data = buf->debugBuffer[tail];
+        DEBUG_MEMORY_BARRIER();
+        buf->debugTail = (tail + 1) & (Size - 1);
         return true;
     }
     return false;
 }
 
 // -----------------------------------------------------------------------------------
-// UART1 initialization procedure
+// Ring buffer raw copy procedure
 // -----------------------------------------------------------------------------------
-// Input : int32_t debugBaud - The desired baud rate for UART1 (e.g., 9600, 115200)
+// Input : debugRing<Size> *buf - Pointer to the ring buffer structure
+// Input : const char *data - Pointer to the bytes to insert
+// Input : uint8_t len - Number of bytes to insert (caller guarantees the space)
+// Input : bool inFlash - data points to program memory (PROGMEM) instead of SRAM
 // Output: void
-// Configures the ATmega328PB's UART1 module for serial transmission with the specified
-// baud rate, 8-bit data, no parity, and 1 stop bit. Enables double-speed mode (U2X1),
-// transmitter (TXEN1), and data register empty interrupt (UDRIE1). Initializes the ring buffer.
-// Uses F_CPU to calculate the baud rate register value (UBRR1).
+// Copies the data in with at most two memcpy (or memcpy_P) calls, before and after the
+// wrap point, then publishes the new head index once. Producer side only.
 // -----------------------------------------------------------------------------------
-void debugSerialBegin(int32_t debugBaud) {
-    uint16_t ubrr = (F_CPU / (8UL * debugBaud)) - 1;
-    UBRR1H = (uint8_t)(ubrr >> 8);
-    UBRR1L = (uint8_t)ubrr;
-    UCSR1A |= (1 << U2X1); // Double speed mode
-    UCSR1B = (1 << TXEN1) | (1 << UDRIE1); // Enable TX and data register empty interrupt
-    UCSR1C = (1 << UCSZ11) | (1 << UCSZ10); // 8-bit data, no parity, 1 stop bit
-    
-    debug_buffer_init(&debugTxBuffer);
+template <uint16_t Size>
+static void debug_buffer_copy(debugRing<Size> *buf, const char *data, uint8_t len, bool inFlash) {
+    uint8_t head = buf->debugHead;
+    uint16_t first = Size - head;
+    if (first > len) {
+        first = len;
+    }
+    if (inFlash) {
+        memcpy_P(&buf->debugBuffer[head], data, first);
+        memcpy_P(&buf->debugBuffer[0], data + first, len - first);
+    } else {
+        memcpy(&buf->debugBuffer[head], data, first);
+        memcpy(&buf->debugBuffer[0], data + first, len - first);
+    }
+    DEBUG_MEMORY_BARRIER();
+    buf->debugHead = (head + len) & (Size - 1);
 }
 
 // -----------------------------------------------------------------------------------
-// UART1 single character transmission procedure
+// Statistics update procedures (DEBUG_STATS)
 // -----------------------------------------------------------------------------------
-// Input : char data - The character to transmit via UART1
+// Template: uint8_t C - Channel number
+// Input : uint8_t len - Number of bytes
 // Output: void
-// Adds the character to the ring buffer and enables the UART1 data register empty
-// interrupt (UDRIE1) if the buffer was previously empty. Disables interrupts (cli)
-// during buffer access to prevent race conditions, then re-enables them (sei).
+// debug_stats_queued counts bytes just published and raises the high-water mark,
+// debug_stats_dropped counts bytes lost, and debug_stats_blocked one BLOCK wait for
+// len bytes (none if len is 0). Writers call them inside their critical section.
+// Without DEBUG_STATS they are empty and compile away.
 // -----------------------------------------------------------------------------------
-void uart1_print_char(char data) {
-    cli();
-    bool was_empty = debug_buffer_is_empty(&debugTxBuffer);
-    debug_buffer_put(&debugTxBuffer, data);
-    if (was_empty) {
-        UCSR1B |= (1 << UDRIE1);
+template <uint8_t C>
+static inline void debug_stats_queued(uint8_t len) {
+#if DEBUG_STATS
+    debugStats_t &stats = debugChannel<C>::stats;
+    uint8_t used = debugChannel<C>::usable - debug_buffer_space(&debugChannel<C>::buffer);
+    stats.enqueued += len;
+    if (used > stats.highWater) {
+        stats.highWater = used;
     }
-    sei();
+#else
+    (void)len;
+#endif
+}
+
+template <uint8_t C>
+static inline void debug_stats_dropped(uint8_t len) {
+#if DEBUG_STATS
+    debugChannel<C>::stats.dropped += len;
+#else
+    (void)len;
+#endif
+}
+
+template <uint8_t C>
+static inline void debug_stats_blocked(uint8_t len) {
+#if DEBUG_STATS
+    if (len > 0) {
+        debugChannel<C>::stats.blockedWaits++;
+        debugChannel<C>::stats.blockedBytes += len;
+    }
+#else
+    (void)len;
+#endif
+}
+
+// Binary record states of debug_channel_boundary, between DEBUG_RECORD_TEXT bytes
+enum {
+    DEBUG_RECORD_TEXT = 0,
+    DEBUG_RECORD_LENGTH,        // Token record: the next byte is the payload length
+    DEBUG_RECORD_CHANNEL,       // Telemetry record: the next byte is the channel byte
+    DEBUG_RECORD_BYTES,         // recordLeft bytes of the record remain
+    DEBUG_RECORD_VARINT,        // Delta sample: the varint ends at a byte below 0x80
+    DEBUG_RECORD_STAMP          // Binary timestamp: recordLeft bytes remain
+};
+
+// -----------------------------------------------------------------------------------
+// Message boundary test procedure
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Input : char data - Byte just taken from the channel's ring buffer
+// Output: bool - Returns true if the byte ends a message
+// With DEBUG_FRAMING every frame ends at its 0x00 delimiter. Otherwise a line end
+// closes a message, and so does the last byte of a token or telemetry record, so a
+// steady stream of telemetry records still lets the fault channel in between two of
+// them. Record bytes are walked with the same rules the host decoders use,
+// so a 0x0A inside a record, or inside the binary timestamp that starts a line, never
+// lets another channel cut in. Only called on shared USARTs; a few cycles per byte.
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static inline bool debug_channel_boundary(char data) {
+#if DEBUG_FRAMING
+    return data == 0;
+#else
+    uint8_t &state = debugChannel<C>::recordState;
+    uint8_t &left = debugChannel<C>::recordLeft;
+    uint8_t byte = (uint8_t)data;
+    switch (state) {
+    case DEBUG_RECORD_TEXT:
+        if (byte == DEBUG_TOKEN_START) {
+            state = DEBUG_RECORD_LENGTH;
+        } else if (byte == DEBUG_TELEMETRY_START) {
+            state = DEBUG_RECORD_CHANNEL;
+        } else if (byte == DEBUG_TIMESTAMP_START) {
+            state = DEBUG_RECORD_STAMP;
+            left = 4;
+        } else {
+            return byte == '\n';
+        }
+        return false;
+    case DEBUG_RECORD_LENGTH:
+        left = byte;
+        state = (left > 0) ? DEBUG_RECORD_BYTES : DEBUG_RECORD_TEXT;
+        return left == 0;
+    case DEBUG_RECORD_CHANNEL:
+        if (byte == DEBUG_TELEMETRY_BEGIN) {
+            left = 1;
+            state = DEBUG_RECORD_BYTES;
+        } else if (byte & DEBUG_TELEMETRY_DELTA) {
+            state = DEBUG_RECORD_VARINT;
+        } else {
+            left = 4;
+            state = DEBUG_RECORD_BYTES;
+        }
+        return false;
+    case DEBUG_RECORD_VARINT:
+        if (byte & 0x80) {
+            return false;
+        }
+        state = DEBUG_RECORD_TEXT;
+        return true;
+    case DEBUG_RECORD_STAMP:
+        if (--left == 0) {
+            state = DEBUG_RECORD_TEXT;
+        }
+        return false;               // The line it stamps follows
+    default:
+        if (--left > 0) {
+            return false;
+        }
+        state = DEBUG_RECORD_TEXT;
+        return true;
+    }
+#endif
 }
 
 // -----------------------------------------------------------------------------------
-// String printing procedure
+// Channel byte retrieval procedure
 // -----------------------------------------------------------------------------------
-// Input : const char *str - Pointer to a null-terminated string to transmit
-// Output: void
-// Iterates through the string, sending each character to uart1_print_char for
-// transmission via the ring buffer. Stops when the null terminator is reached.
+// Template: uint8_t C - Channel number
+// Template: uint8_t N - USART number the channel is on
+// Input : char *data - Pointer to store the retrieved character
+// Output: bool - Returns true if a character was retrieved
+// Takes the next byte of channel C and, if the USART is shared, keeps it as the owner
+// until the message ends.
 // -----------------------------------------------------------------------------------
-void debugPrint(const char *str) {
-    while (*str) {
-        uart1_print_char(*str++);
+template <uint8_t C, uint8_t N>
+static inline bool debug_port_take(char *data) {
+    if (!debug_buffer_get(&debugChannel<C>::buffer, data)) {
+        return false;
     }
+    if (DEBUG_PORT_SHARED(N)) {
+        debugPort<N>::owner = debug_channel_boundary<C>(*data) ? DEBUG_CHANNEL_NONE : C;
+    }
+    return true;
 }
 
 // -----------------------------------------------------------------------------------
-// String printing with newline procedure
+// Channel selection procedure
 // -----------------------------------------------------------------------------------
-// Input : const char *str - Pointer to a null-terminated string to transmit
+// Template: uint8_t N - USART number
+// Input : uint8_t owner - Channel in the middle of a message, or DEBUG_CHANNEL_NONE
+// Input : char *data - Pointer to store the retrieved character
+// Output: bool - Returns true if a character was retrieved
+// Continues the owner's message, or, between messages, takes the first byte from the
+// channels on this USART in priority order: fault, text, telemetry. The constant
+// conditions fold away, so a USART with a single channel costs one ring buffer read.
+// -----------------------------------------------------------------------------------
+template <uint8_t N>
+static inline bool debug_port_pick(uint8_t owner, char *data) {
+    return
+#if DEBUG_FAULT_BUFFER_SIZE > 0
+        (DEBUG_FAULT_ON(N) && (owner == DEBUG_CHANNEL_NONE || owner == DEBUG_CHANNEL_FAULT) &&
+         debug_port_take<DEBUG_CHANNEL_FAULT, N>(data)) ||
+#endif
+        (DEBUG_TEXT_ON(N) && (owner == DEBUG_CHANNEL_NONE || owner == DEBUG_CHANNEL_TEXT) &&
+         debug_port_take<DEBUG_CHANNEL_TEXT, N>(data)) ||
+#if DEBUG_TELEMETRY_BUFFER_SIZE > 0
+        (DEBUG_TELEMETRY_ON(N) && (owner == DEBUG_CHANNEL_NONE || owner == DEBUG_CHANNEL_TELEMETRY) &&
+         debug_port_take<DEBUG_CHANNEL_TELEMETRY, N>(data)) ||
+#endif
+        false;
+}
+
+// -----------------------------------------------------------------------------------
+// USART byte output procedure
+// -----------------------------------------------------------------------------------
+// Template: uint8_t N - USART number
+// Input : char data - The byte to send (UDREn must be set)
 // Output: void
-// Prints the string using debugPrint, then appends a carriage return ('\r') and
-// newline ('\n') to the ring buffer for transmission, simulating a line break.
+// Writes the byte to UDRn and clears TXCn, so TXCn reports the end of the last byte
+// for debugFlush.
 // -----------------------------------------------------------------------------------
-void debugPrintln(const char *str) {
-    debugPrint(str);
-    uart1_print_char('\r');
-    uart1_print_char('\n');
+template <uint8_t N>
+static inline void debug_port_send(char data) {
+    typedef debugUsart<N> usart;
+    usart::udr() = data;
+    usart::ucsra() |= (1 << usart::txc);    // Writing one clears TXCn
+    debugPort<N>::active = true;
 }
 
 // -----------------------------------------------------------------------------------
-// Integer printing procedure
+// USART transmit service procedure
 // -----------------------------------------------------------------------------------
-// Input : int32_t value - The 32-bit integer to transmit
+// Template: uint8_t N - USART number
+// Output: bool - Returns true if a byte was sent
+// Body of the data register empty interrupt of USART N, also run by a BLOCK writer
+// polling with interrupts disabled and by panic mode. Moves the next byte of the
+// scheduled channel into UDRn. An owner whose buffer ran empty loses the USART, so a
+// message that a higher-priority channel was waiting behind is only held up while more
+// of it is still being written. If every channel is empty, disables the interrupt
+// (UDRIEn).
+// -----------------------------------------------------------------------------------
+template <uint8_t N>
+static inline bool debug_port_service(void) {
+    typedef debugUsart<N> usart;
+    uint8_t owner = DEBUG_PORT_SHARED(N) ? debugPort<N>::owner : DEBUG_CHANNEL_NONE;
+    char data;
+    bool sent = debug_port_pick<N>(owner, &data);
+    if (!sent && owner != DEBUG_CHANNEL_NONE) {
+        debugPort<N>::owner = DEBUG_CHANNEL_NONE;
+        sent = debug_port_pick<N>(DEBUG_CHANNEL_NONE, &data);
+    }
+    if (sent) {
+        debug_port_send<N>(data);
+    } else {
+        usart::ucsrb() &= ~(1 << usart::udrie);
+    }
+    return sent;
+}
+
+// -----------------------------------------------------------------------------------
+// USART polled drain procedure
+// -----------------------------------------------------------------------------------
+// Template: uint8_t N - USART number
 // Output: void
-// Converts the integer to its decimal representation. Handles negative numbers by
-// printing a minus sign and converting to positive. For zero, prints '0'. Otherwise,
-// builds a digit array in reverse order, then transmits digits in correct order via
-// the ring buffer.
+// Disables the data register empty interrupt of USART N, then sends everything its
+// channels have queued by polling UDREn and running the transmit service. Never reads
+// or changes the global interrupt flag: with UDRIEn cleared the ISR cannot run whether
+// interrupts are enabled or not. Returns once the last byte is in UDRn.
 // -----------------------------------------------------------------------------------
-void debugPrintInt(int32_t value) {
-    if (value < 0) {
-        uart1_print_char('-');
-        value = -value;
+template <uint8_t N>
+static void debug_port_drain(void) {
+    typedef debugUsart<N> usart;
+    usart::ucsrb() &= ~(1 << usart::udrie);
+    do {
+        while (!(usart::ucsra() & (1 << usart::udre))) {
+        }
+    } while (debug_port_service<N>());
+}
+
+#if DEBUG_OVERFLOW_POLICY == DEBUG_OVERFLOW_BLOCK
+// -----------------------------------------------------------------------------------
+// Ring buffer wait-for-space procedure (DEBUG_OVERFLOW_BLOCK)
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Input : uint8_t len - Number of free bytes required (at most the channel's size - 1)
+// Output: uint8_t - Number of bytes waited for (0 if the space was already free)
+// Spins until the ISR has drained enough bytes, first enabling UDRIEn so that bytes
+// published by an earlier chunk of the same write start moving. If global interrupts
+// are disabled the ISR cannot run, so the caller takes over as consumer: it polls UDREn
+// and runs the transmit service itself until enough space is free.
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static uint8_t debug_buffer_wait(uint8_t len) {
+    typedef debugUsart<debugChannel<C>::usart> usart;
+    uint8_t space = debug_buffer_space(&debugChannel<C>::buffer);
+    if (space >= len) {
+        return 0;
     }
-    
-    if (value == 0) {
-        uart1_print_char('0');
-        return;
+    usart::ucsrb() |= (1 << usart::udrie);
+    while (debug_buffer_space(&debugChannel<C>::buffer) < len) {
+        if (!(SREG & (1 << SREG_I)) && (usart::ucsra() & (1 << usart::udre))) {
+            debug_port_service<debugChannel<C>::usart>();
+        }
     }
+    return len - space;
+}
+#endif
 
-    char digits[10];
-    uint8_t count = 0;
-    
-    while (value > 0) {
-        digits[count++] = '0' + (value % 10);
-        value /= 10;
+#if DEBUG_OVERFLOW_POLICY == DEBUG_OVERFLOW_DROP_OLDEST
+// -----------------------------------------------------------------------------------
+// Channel discard-oldest procedure (DEBUG_OVERFLOW_DROP_OLDEST)
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Input : uint8_t len - Number of free bytes required (at most the usable buffer size)
+// Output: uint8_t - Number of bytes discarded
+// Advances the tail past the oldest queued bytes until len bytes are free. The tail
+// normally belongs to the ISR, so interrupts are masked here even without
+// DEBUG_ISR_SAFE; the previous interrupt state (SREG) is restored afterwards.
+// With DEBUG_FRAMING whole frames are discarded: the tail moves up to a 0x00 delimiter
+// and leaves it queued, so a frame the ISR has already started is still terminated and
+// the host sees one cut frame plus a sequence gap, not frames run together. This scans
+// the dropped bytes with interrupts masked (at most the usable buffer size).
+// Otherwise the dropped bytes are the rest of the line or record the ISR is in, so the
+// record state goes back to text and the channel gives up the USART: the walk would
+// misread the bytes after the cut, and another channel may take over there.
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static uint8_t debug_channel_discard(uint8_t len) {
+    typedef debugChannel<C> ch;
+    debugRing<ch::size> *buf = &ch::buffer;
+    uint8_t sreg = SREG;
+    cli();
+    uint8_t space = debug_buffer_space(buf);
+    uint8_t discarded = 0;
+#if DEBUG_FRAMING
+    uint8_t tail = buf->debugTail;
+    uint8_t head = buf->debugHead;
+    while (space < len && tail != head) {
+        do {
+            tail = (tail + 1) & ch::mask;
+            space++;
+            discarded++;
+        } while (tail != head && buf->debugBuffer[tail] != 0);
+    }
+    buf->debugTail = tail;
+#else
+    if (space < len) {
+        discarded = len - space;
+        buf->debugTail = (buf->debugTail + discarded) & ch::mask;
+        ch::recordState = DEBUG_RECORD_TEXT;
+        if (debugPort<ch::usart>::owner == C) {
+            debugPort<ch::usart>::owner = DEBUG_CHANNEL_NONE;
+        }
+    }
+#endif
+    SREG = sreg;
+    return discarded;
+}
+#endif
+
+#if (DEBUG_OVERFLOW_POLICY == DEBUG_OVERFLOW_MARK) && !DEBUG_FRAMING
+// -----------------------------------------------------------------------------------
+// Drop marker emission procedure (DEBUG_OVERFLOW_MARK)
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Input : uint8_t len - Size of the message waiting to be inserted after the marker
+// Output: bool - Returns true if the message may be inserted, false if it is dropped
+// While no bytes have been dropped this only checks for space. Otherwise it formats
+// "[N bytes dropped]" and queues it ahead of the message once both fit; until then the
+// message is dropped too and added to the count (saturating at 65535).
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static bool debug_buffer_mark(uint8_t len) {
+    debugRing<debugChannel<C>::size> *buf = &debugChannel<C>::buffer;
+    uint16_t &debugDroppedBytes = debugChannel<C>::droppedBytes;
+    uint8_t space = debug_buffer_space(buf);
+    if (debugDroppedBytes == 0 && space >= len) {
+        return true;
     }
 
-    while (count > 0) {
-        uart1_print_char(digits[--count]);
+    char marker[24];
+    static const char suffix[] PROGMEM = " bytes dropped]";
+    uint8_t markerLen = 0;
+    marker[markerLen++] = '[';
+    markerLen += debug_format_uint32(&marker[markerLen], debugDroppedBytes, 1);
+    memcpy_P(&marker[markerLen], suffix, sizeof(suffix) - 1);
+    markerLen += sizeof(suffix) - 1;
+
+    if (debugDroppedBytes == 0 || space < markerLen + len) {
+        debugDroppedBytes = (debugDroppedBytes > 0xFFFF - len) ? 0xFFFF : debugDroppedBytes + len;
+        return false;
     }
+    debug_buffer_copy(buf, marker, markerLen, false);
+    debug_stats_queued<C>(markerLen);
+    debugDroppedBytes = 0;
+    return true;
 }
+#endif
+
+#if DEBUG_FRAMING
+// Write position of a frame being COBS-encoded into a ring buffer
+template <uint16_t Size>
+struct debugFrameCursor {
+    debugRing<Size> *buf;
+    uint8_t pos;        // Next free slot
+    uint8_t codePos;    // Slot reserved for the current block's code byte
+    uint8_t code;       // Current block length + 1
+};
 
 // -----------------------------------------------------------------------------------
-// Integer printing with newline procedure
+// Frame byte encoding procedure (DEBUG_FRAMING)
 // -----------------------------------------------------------------------------------
-// Input : int32_t value - The 32-bit integer to transmit
+// Input : debugFrameCursor<Size> *c - Frame being written
+// Input : uint8_t data - Next unencoded byte
 // Output: void
-// Prints the integer using debugPrintInt, then appends a carriage return ('\r') and
-// newline ('\n') to the ring buffer for transmission, simulating a line break.
+// COBS-encodes one byte straight into the ring buffer: a zero closes the current block
+// by filling in its reserved code byte and reserves the next one; other bytes are
+// stored as is. Nothing is visible to the ISR until debug_frame_emit publishes the head.
 // -----------------------------------------------------------------------------------
-void debugPrintIntln(int32_t value) {
-    debugPrintInt(value);
-    uart1_print_char('\r');
-    uart1_print_char('\n');
+template <uint16_t Size>
+static void debug_frame_put(debugFrameCursor<Size> *c, uint8_t data) {
+    if (data == 0) {
+        c->buf->debugBuffer[c->codePos] = c->code;
+        c->codePos = c->pos;
+        c->code = 1;
+    } else {
+        c->buf->debugBuffer[c->pos] = data;
+        c->code++;
+    }
+    c->pos = (c->pos + 1) & (Size - 1);
 }
 
 // -----------------------------------------------------------------------------------
-// Floating-point number printing procedure
+// Frame sequence number procedure (DEBUG_FRAMING)
 // -----------------------------------------------------------------------------------
-// Input : float value - The floating-point number to transmit
-// Input : uint8_t decimalPlaces - Number of decimal places to display (0 or more)
+// Template: uint8_t C - Channel number
+// Output: uint8_t - Sequence byte for the channel's next frame
+// The channel number rides in the top two bits of the sequence byte, so the host can
+// count gaps per channel when several share a USART.
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static inline uint8_t debug_frame_seq(void) {
+    return (uint8_t)((C << DEBUG_FRAME_SEQ_BITS) | (debugChannel<C>::frameSeq++ & DEBUG_FRAME_SEQ_MASK));
+}
+
+// -----------------------------------------------------------------------------------
+// Frame encoding procedure (DEBUG_FRAMING)
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Input : uint8_t seq - Sequence byte from debug_frame_seq
+// Input : const char *data - Pointer to the data (at most debugChannel<C>::frameMax bytes)
+// Input : uint8_t len - Number of data bytes
+// Input : bool inFlash - data points to program memory (PROGMEM) instead of SRAM
 // Output: void
-// Prints the float by first handling the sign (negative prints '-'). Converts the
-// integer part to an integer and prints it using debugPrintInt. If decimalPlaces > 0,
-// prints a decimal point and converts the fractional part to digits by repeatedly
-// multiplying by 10, extracting, and transmitting each digit.
+// Encodes sequence, data and CRC in one pass, updating the CRC as each byte is
+// enqueued. The caller guarantees len + DEBUG_FRAME_OVERHEAD free bytes. The head is
+// published once, after the delimiter.
 // -----------------------------------------------------------------------------------
-void debugPrintFloat(float value, uint8_t decimalPlaces) {
-    if (value < 0) {
-        uart1_print_char('-');
-        value = -value;
+template <uint8_t C>
+static void debug_frame_encode(uint8_t seq, const char *data, uint8_t len, bool inFlash) {
+    typedef debugChannel<C> ch;
+    debugRing<ch::size> *buf = &ch::buffer;
+    debugFrameCursor<ch::size> c;
+    uint8_t start = buf->debugHead;
+    c.buf = buf;
+    c.codePos = start;
+    c.pos = (c.codePos + 1) & ch::mask;
+    c.code = 1;
+
+    uint16_t crc = _crc_ccitt_update(0xFFFF, seq);
+    debug_frame_put(&c, seq);
+    for (uint8_t i = 0; i < len; i++) {
+        uint8_t byte = inFlash ? pgm_read_byte(&data[i]) : (uint8_t)data[i];
+        crc = _crc_ccitt_update(crc, byte);
+        debug_frame_put(&c, byte);
+    }
+    debug_frame_put(&c, (uint8_t)crc);
+    debug_frame_put(&c, (uint8_t)(crc >> 8));
+
+    buf->debugBuffer[c.codePos] = c.code;
+    buf->debugBuffer[c.pos] = 0;
+    DEBUG_MEMORY_BARRIER();
+    buf->debugHead = (c.pos + 1) & ch::mask;
+    debug_stats_queued<C>((uint8_t)((c.pos + 1 - start) & ch::mask));
+}
+
+// -----------------------------------------------------------------------------------
+// Frame emission procedure (DEBUG_FRAMING)
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Input : const char *data - Pointer to the data (at most debugChannel<C>::frameMax bytes)
+// Input : uint8_t len - Number of data bytes
+// Input : bool inFlash - data points to program memory (PROGMEM) instead of SRAM
+// Output: bool - Returns true if the frame was queued
+// Takes the channel's next sequence number, makes room for the worst-case frame
+// according to the overflow policy, then encodes the frame in one critical section.
+// A frame that does not fit is dropped whole; it still uses up its sequence number,
+// which is how the host sees the loss. BLOCK waits with interrupts in the caller's
+// state and re-checks the space once masked, since an ISR may have written meanwhile.
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static bool debug_frame_emit(const char *data, uint8_t len, bool inFlash) {
+    uint8_t needed = len + DEBUG_FRAME_OVERHEAD;
+#if DEBUG_OVERFLOW_POLICY == DEBUG_OVERFLOW_BLOCK
+    for (;;) {
+        uint8_t waited = debug_buffer_wait<C>(needed);
+        debugCritical critical;
+        debug_stats_blocked<C>(waited);
+        if (debug_buffer_space(&debugChannel<C>::buffer) >= needed) {
+            debug_frame_encode<C>(debug_frame_seq<C>(), data, len, inFlash);
+            return true;
+        }
+    }
+#else
+    debugCritical critical;
+    uint8_t seq = debug_frame_seq<C>();
+#if DEBUG_OVERFLOW_POLICY == DEBUG_OVERFLOW_DROP_OLDEST
+    debug_stats_dropped<C>(debug_channel_discard<C>(needed));
+#else
+    if (debug_buffer_space(&debugChannel<C>::buffer) < needed) {
+        debug_stats_dropped<C>(needed);
+        return false;
+    }
+#endif
+    debug_frame_encode<C>(seq, data, len, inFlash);
+    return true;
+#endif
+}
+#endif
+
+// -----------------------------------------------------------------------------------
+// Ring buffer bulk insertion procedure
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Input : const char *data - Pointer to the bytes to insert
+// Input : uint8_t len - Number of bytes to insert
+// Input : bool inFlash - data points to program memory (PROGMEM) instead of SRAM
+// Output: uint8_t - Number of bytes actually inserted
+// Applies the compile-time overflow policy (DEBUG_OVERFLOW_POLICY) when len exceeds
+// the free space, then copies the bytes in and publishes the new head once:
+// - DROP_NEWEST:  inserts what fits and discards the rest of the data.
+// - DROP_OLDEST:  discards the oldest queued bytes to make room; of data longer than
+//                 the buffer only the last (size - 1) bytes are kept.
+// - BLOCK:        waits for the transmitter, in buffer-sized chunks if needed.
+// - DROP_MESSAGE: inserts all of the data or none of it.
+// - MARK:         as DROP_MESSAGE, and reports the dropped byte count in-band.
+// With DEBUG_FRAMING the data is sent as frames of up to debugChannel<C>::frameMax
+// bytes, each queued whole or dropped whole (MARK then behaves as DROP_MESSAGE, the
+// sequence numbers already report the loss).
+// Each copy (each frame or BLOCK chunk) is one debugCritical section, so a write from
+// an ISR lands before or after the interrupted one, never inside it.
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static uint8_t debug_buffer_write(const char *data, uint8_t len, bool inFlash) {
+    typedef debugChannel<C> ch;
+    debugRing<ch::size> *buf = &ch::buffer;
+#if DEBUG_FRAMING
+    (void)buf;
+    uint8_t queued = 0;
+    while (len > 0) {
+        uint8_t chunk = (len > ch::frameMax) ? (uint8_t)ch::frameMax : len;
+        if (debug_frame_emit<C>(data, chunk, inFlash)) {
+            queued += chunk;
+        }
+        data += chunk;
+        len -= chunk;
     }
-    
-    // Handle integer part
-    int32_t intPart = (int32_t)value;
-    debugPrintInt(intPart);
-    
-    // Handle decimal part
-    if (decimalPlaces > 0) {
-        uart1_print_char('.');
-        float decimalPart = value - intPart;
-        
-        // Convert decimal part to integer by multiplying by 10^decimalPlaces
-        for (uint8_t i = 0; i < decimalPlaces; i++) {
-            decimalPart *= 10;
-            int digit = (int)decimalPart;
-            uart1_print_char('0' + digit);
-            decimalPart -= digit;
+    return queued;
+#elif DEBUG_OVERFLOW_POLICY == DEBUG_OVERFLOW_BLOCK
+    uint8_t remaining = len;
+    while (remaining > 0) {
+        uint8_t chunk = (remaining > ch::usable) ? (uint8_t)ch::usable : remaining;
+        uint8_t waited = debug_buffer_wait<C>(chunk);
+        debugCritical critical;
+        debug_stats_blocked<C>(waited);
+        if (debug_buffer_space(buf) >= chunk) {
+            debug_buffer_copy(buf, data, chunk, inFlash);
+            debug_stats_queued<C>(chunk);
+            data += chunk;
+            remaining -= chunk;
         }
     }
+    return len;
+#elif DEBUG_OVERFLOW_POLICY == DEBUG_OVERFLOW_DROP_OLDEST
+    uint8_t skipped = 0;
+    if (len > ch::usable) {
+        skipped = len - ch::usable;
+        data += skipped;
+        len = ch::usable;
+    }
+    debugCritical critical;
+    debug_stats_dropped<C>(skipped);
+    debug_stats_dropped<C>(debug_channel_discard<C>(len));
+    debug_buffer_copy(buf, data, len, inFlash);
+    debug_stats_queued<C>(len);
+    return len;
+#elif DEBUG_OVERFLOW_POLICY == DEBUG_OVERFLOW_DROP_MESSAGE
+    debugCritical critical;
+    if (debug_buffer_space(buf) < len) {
+        debug_stats_dropped<C>(len);
+        return 0;
+    }
+    debug_buffer_copy(buf, data, len, inFlash);
+    debug_stats_queued<C>(len);
+    return len;
+#elif DEBUG_OVERFLOW_POLICY == DEBUG_OVERFLOW_MARK
+    debugCritical critical;
+    if (!debug_buffer_mark<C>(len)) {
+        debug_stats_dropped<C>(len);
+        return 0;
+    }
+    debug_buffer_copy(buf, data, len, inFlash);
+    debug_stats_queued<C>(len);
+    return len;
+#else
+    debugCritical critical;
+    uint8_t space = debug_buffer_space(buf);
+    if (len > space) {
+        debug_stats_dropped<C>(len - space);
+        len = space;
+    }
+    debug_buffer_copy(buf, data, len, inFlash);
+    debug_stats_queued<C>(len);
+    return len;
+#endif
 }
 
 // -----------------------------------------------------------------------------------
-// Floating-point number printing with newline procedure
+// Ring buffer data insertion procedure
 // -----------------------------------------------------------------------------------
-// Input : float value - The floating-point number to transmit
-// Input : uint8_t decimalPlaces - Number of decimal places to display (0 or more)
+// Template: uint8_t C - Channel number
+// Input : char data - The character to insert into the buffer
 // Output: void
-// Prints the float using debugPrintFloat, then appends a carriage return ('\r') and
-// newline ('\n') to the ring buffer for transmission, simulating a line break.
+// Adds a character to the ring buffer at the head position if the buffer is not full,
+// then advances the head index (masked to the buffer size). Ignores the data if the buffer is full.
+// Producer side only: the character is stored before the new head is published.
+// Policies other than DROP_NEWEST, and framed output, go through debug_buffer_write.
 // -----------------------------------------------------------------------------------
-void debugPrintFloatln(float value, uint8_t decimalPlaces) {
-    debugPrintFloat(value, decimalPlaces);
-    uart1_print_char('\r');
-    uart1_print_char('\n');
+template <uint8_t C>
+static void debug_buffer_put(char data) {
+#if (DEBUG_OVERFLOW_POLICY == DEBUG_OVERFLOW_DROP_NEWEST) && !DEBUG_FRAMING
+    debugRing<debugChannel<C>::size> *buf = &debugChannel<C>::buffer;
+    debugCritical critical;
+    uint8_t head = buf->debugHead;
+    uint8_t next = (head + 1) & debugChannel<C>::mask;
+    if (next != buf->debugTail) {
+        buf->debugBuffer[head] = data;
+        DEBUG_MEMORY_BARRIER();
+        buf->debugHead = next;
+        debug_stats_queued<C>(1);
+    } else {
+        debug_stats_dropped<C>(1);
+    }
+#else
+    debug_buffer_write<C>(&data, 1, false);
+#endif
 }
 
 // -----------------------------------------------------------------------------------
-// UART1 data register empty interrupt service routine
+// USART initialization procedure
 // -----------------------------------------------------------------------------------
-// Input : None (ISR triggered by hardware)
-// Output: None
-// Handles the UART1 data register empty interrupt (USART1_UDRE_vect). Retrieves a
-// character from the ring buffer and writes it to the UART1 data register (UDR1).
-// If the buffer is empty, disables the data register empty interrupt (UDRIE1).
+// Template: uint8_t N - USART number
+// Input : uint16_t ubrr - Baud rate register value
+// Input : bool doubleSpeed - Use double-speed mode (U2Xn, 8 clocks per bit)
+// Output: void
+// Configures USART N for 8-bit data, no parity and 1 stop bit, enables the transmitter
+// and its data register empty interrupt, and drives the TX pin to the idle level.
 // -----------------------------------------------------------------------------------
-ISR(USART1_UDRE_vect) {
-    char data;
-    if (debug_buffer_get(&debugTxBuffer, &data)) {
-        UDR1 = data;
+template <uint8_t N>
+static void debug_port_begin(uint16_t ubrr, bool doubleSpeed) {
+    typedef debugUsart<N> usart;
+    usart::txIdle();
+    usart::ubrrh() = (uint8_t)(ubrr >> 8);
+    usart::ubrrl() = (uint8_t)ubrr;
+    if (doubleSpeed) {
+        usart::ucsra() |= (1 << usart::u2x); // Double speed mode
     } else {
-        UCSR1B &= ~(1 << UDRIE1);
+        usart::ucsra() &= ~(1 << usart::u2x);
+    }
+    usart::ucsrb() = (1 << usart::txen) | (1 << usart::udrie); // Enable TX and data register empty interrupt
+    usart::ucsrc() = (1 << usart::ucsz1) | (1 << usart::ucsz0); // 8-bit data, no parity, 1 stop bit
+    debugPort<N>::owner = DEBUG_CHANNEL_NONE;
+    debugPort<N>::active = false;
+}
+
+// -----------------------------------------------------------------------------------
+// Channel initialization procedure
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Output: void
+// Empties the channel's ring buffer; with DEBUG_FRAMING queues a leading delimiter so
+// the host syncs on the first frame. The next text line gets a timestamp.
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static void debug_channel_begin(void) {
+    debug_buffer_init(&debugChannel<C>::buffer);
+#if DEBUG_TIMESTAMP
+    debugChannel<C>::lineStart = true;
+#endif
+#if !DEBUG_FRAMING
+    debugChannel<C>::recordState = DEBUG_RECORD_TEXT;
+#endif
+#if DEBUG_FRAMING
+    static const char delimiter = 0;
+    debug_buffer_copy(&debugChannel<C>::buffer, &delimiter, 1, false);
+#endif
+}
+
+// -----------------------------------------------------------------------------------
+// Transmitter start procedure
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Output: void
+// Enables the data register empty interrupt of the channel's USART. Called after the
+// head is published, so the ISR can never disable itself while data is pending.
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static inline void debug_channel_kick(void) {
+    typedef debugUsart<debugChannel<C>::usart> usart;
+    usart::ucsrb() |= (1 << usart::udrie);
+}
+
+// -----------------------------------------------------------------------------------
+// Synchronous transmission procedure (panic mode)
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Input : const char *data - Pointer to the bytes to transmit
+// Input : uint8_t len - Number of bytes to transmit
+// Input : bool inFlash - data points to program memory (PROGMEM) instead of SRAM
+// Output: uint8_t - Number of bytes sent (always len)
+// First drains whatever the channel's USART still has queued, then writes the data
+// straight to UDRn, polling UDREn before each byte. With DEBUG_FRAMING each chunk of
+// up to debugChannel<C>::frameMax bytes is encoded into the now empty ring buffer and
+// drained the same way, so the host tools keep working. Returns once the last byte is
+// in UDRn; debugFlush waits for it to leave the pin.
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static uint8_t debug_panic_write(const char *data, uint8_t len, bool inFlash) {
+    enum { N = debugChannel<C>::usart };
+    debug_port_drain<N>();
+#if DEBUG_FRAMING
+    for (uint8_t remaining = len; remaining > 0; ) {
+        uint8_t chunk = (remaining > debugChannel<C>::frameMax) ? (uint8_t)debugChannel<C>::frameMax : remaining;
+        debug_frame_encode<C>(debug_frame_seq<C>(), data, chunk, inFlash);
+        debug_port_drain<N>();
+        data += chunk;
+        remaining -= chunk;
+    }
+#else
+    typedef debugUsart<N> usart;
+    for (uint8_t i = 0; i < len; i++) {
+        char byte = inFlash ? (char)pgm_read_byte(&data[i]) : data[i];
+        while (!(usart::ucsra() & (1 << usart::udre))) {
+        }
+        debug_port_send<N>(byte);
+    }
+    debug_stats_queued<C>(len);
+#endif
+    return len;
+}
+
+// -----------------------------------------------------------------------------------
+// Channel bulk transmission procedure
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Input : const char *data - Pointer to the bytes to transmit
+// Input : uint8_t len - Number of bytes to transmit
+// Input : bool inFlash - data points to program memory (PROGMEM) instead of SRAM
+// Output: uint8_t - Number of bytes queued
+// In panic mode the bytes are sent synchronously instead (debug_panic_write).
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static uint8_t debug_channel_write(const char *data, uint8_t len, bool inFlash) {
+    if (debugPanicMode) {
+        return debug_panic_write<C>(data, len, inFlash);
+    }
+    uint8_t queued = debug_buffer_write<C>(data, len, inFlash);
+    if (queued > 0) {
+        debug_channel_kick<C>();
     }
-}
\ No newline at end of file
+    return queued;
+}
+
+#if DEBUG_TIMESTAMP
+// Longest stamp: a binary record, or "[4294967295] "
+#if DEBUG_TIMESTAMP == DEBUG_TIMESTAMP_BINARY
+#define DEBUG_TIMESTAMP_LENGTH 5
+#else
+#define DEBUG_TIMESTAMP_LENGTH 13
+#endif
+
+// -----------------------------------------------------------------------------------
+// Line timestamp procedure (DEBUG_TIMESTAMP)
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Input : uint8_t len - Length of the write that starts the line
+// Output: void
+// Queues debugTimestamp() as "[ticks] ", formatted by the division-free digit engine,
+// or as a binary DEBUG_TIMESTAMP_START record. Under the dropping overflow policies
+// the stamp is left out unless the write after it fits too, so a dropped line leaves
+// no orphan stamp and a binary stamp is never cut.
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static void debug_timestamp_put(uint8_t len) {
+    uint32_t now = debugTimestamp();
+#if DEBUG_TIMESTAMP == DEBUG_TIMESTAMP_BINARY
+    char stamp[5] = {
+        DEBUG_TIMESTAMP_START, (char)now, (char)(now >> 8), (char)(now >> 16), (char)(now >> 24)
+    };
+    uint8_t n = sizeof(stamp);
+#else
+    char stamp[DEBUG_TIMESTAMP_LENGTH];
+    stamp[0] = '[';
+    uint8_t n = 1 + debug_format_uint32(&stamp[1], now, 1);
+    stamp[n++] = ']';
+    stamp[n++] = ' ';
+#endif
+#if (DEBUG_OVERFLOW_POLICY != DEBUG_OVERFLOW_BLOCK) && (DEBUG_OVERFLOW_POLICY != DEBUG_OVERFLOW_DROP_OLDEST)
+    if (!debugPanicMode) {
+        debugCritical critical;     // Keeps ISR writers out between the check and the copy
+        uint16_t need = (uint16_t)n + len + (DEBUG_FRAMING ? 2 * DEBUG_FRAME_OVERHEAD : 0);
+        if (debug_buffer_space(&debugChannel<C>::buffer) >= need) {
+            debug_channel_write<C>(stamp, n, false);
+        }
+        return;
+    }
+#else
+    (void)len;
+#endif
+    debug_channel_write<C>(stamp, n, false);
+}
+#endif
+
+// -----------------------------------------------------------------------------------
+// Channel text transmission procedure
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Input : const char *data - Pointer to the bytes to transmit
+// Input : uint8_t len - Number of bytes to transmit
+// Input : bool inFlash - data points to program memory (PROGMEM) instead of SRAM
+// Output: uint8_t - Number of bytes queued
+// As debug_channel_write; with DEBUG_TIMESTAMP a write that starts a line is preceded
+// by its timestamp, and a write whose last queued byte is '\n' makes the next one start
+// a line. A write the overflow policy dropped leaves the line state unchanged.
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static uint8_t debug_text_channel_write(const char *data, uint8_t len, bool inFlash) {
+#if DEBUG_TIMESTAMP
+    if (len == 0) {
+        return 0;
+    }
+    if (debugChannel<C>::lineStart) {
+        debug_timestamp_put<C>(len);
+    }
+    uint8_t queued = debug_channel_write<C>(data, len, inFlash);
+    if (queued) {                   // A dropped write leaves the line where it was
+        char last = inFlash ? (char)pgm_read_byte(&data[queued - 1]) : data[queued - 1];
+        debugChannel<C>::lineStart = (last == '\n');
+    }
+    return queued;
+#else
+    return debug_channel_write<C>(data, len, inFlash);
+#endif
+}
+
+// -----------------------------------------------------------------------------------
+// Text output routing procedure
+// -----------------------------------------------------------------------------------
+// Input : const char *data - Pointer to the bytes to transmit
+// Input : uint8_t len - Number of bytes to transmit
+// Input : bool inFlash - data points to program memory (PROGMEM) instead of SRAM
+// Output: uint8_t - Number of bytes queued
+// Sends text output to the channel chosen with debugChannelSelect. Without extra
+// channels this is a direct call into the text channel.
+// -----------------------------------------------------------------------------------
+static uint8_t debug_text_write(const char *data, uint8_t len, bool inFlash) {
+#if DEBUG_FAULT_BUFFER_SIZE > 0
+    if (debugSelectedChannel == DEBUG_CHANNEL_FAULT) {
+        return debug_text_channel_write<DEBUG_CHANNEL_FAULT>(data, len, inFlash);
+    }
+#endif
+#if DEBUG_TELEMETRY_BUFFER_SIZE > 0
+    if (debugSelectedChannel == DEBUG_CHANNEL_TELEMETRY) {
+        return debug_text_channel_write<DEBUG_CHANNEL_TELEMETRY>(data, len, inFlash);
+    }
+#endif
+    return debug_text_channel_write<DEBUG_CHANNEL_TEXT>(data, len, inFlash);
+}
+
+#if DEBUG_TIMER1_USED
+// -----------------------------------------------------------------------------------
+// Timer1 start procedure (DEBUG_PROFILE, DEBUG_TIMESTAMP)
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: void
+// Restarts Timer1 from 0 in normal mode at the DEBUG_TIMESTAMP_PRESCALER clock and,
+// for Timer1 timestamps, enables the overflow interrupt that extends it to 32 bits.
+// The 16-bit TCNT1 write goes through the shared TEMP latch, so interrupts are masked.
+// -----------------------------------------------------------------------------------
+static void debug_timer1_begin(void) {
+    uint8_t sreg = SREG;
+    cli();
+    TCCR1B = 0;                 // Stopped while it is set up
+    TCCR1A = 0;
+    TCNT1 = 0;
+    TIFR1 = (1 << TOV1);        // Cleared by writing a one
+#if DEBUG_TIMESTAMP && !defined(DEBUG_TIMESTAMP_SOURCE)
+    debugTimestampHigh = 0;
+    TIMSK1 |= (1 << TOIE1);
+#endif
+    TCCR1B = DEBUG_TIMER1_CLOCK;
+    SREG = sreg;
+}
+#endif
+
+// -----------------------------------------------------------------------------------
+// UART initialization procedure (precomputed divisor)
+// -----------------------------------------------------------------------------------
+// Input : uint16_t ubrr - Baud rate register value (0 to 4095)
+// Input : bool doubleSpeed - Use double-speed mode (U2X, 8 clocks per bit)
+// Output: void
+// Empties every channel's ring buffer, then configures each USART a channel uses
+// (DEBUG_USART, UART1 on the ATmega328PB by default, plus DEBUG_TELEMETRY_USART and
+// DEBUG_FAULT_USART when those channels are enabled) with the given divisor, 8-bit
+// data, no parity, and 1 stop bit. Enables global interrupts (sei) so the
+// interrupt-driven transmitter can run; the print functions never touch them.
+// DEBUG_PROFILE and DEBUG_TIMESTAMP builds also restart Timer1 from 0, and the former
+// clear the profile.
+// debugSerialBegin<baud>() calls this with a divisor worked out at compile time.
+// -----------------------------------------------------------------------------------
+void debugSerialBeginUbrr(uint16_t ubrr, bool doubleSpeed) {
+    debug_channel_begin<DEBUG_CHANNEL_TEXT>();
+#if DEBUG_TELEMETRY_BUFFER_SIZE > 0
+    debug_channel_begin<DEBUG_CHANNEL_TELEMETRY>();
+#endif
+#if DEBUG_FAULT_BUFFER_SIZE > 0
+    debug_channel_begin<DEBUG_CHANNEL_FAULT>();
+#endif
+#if DEBUG_PORT_USED(0)
+    debug_port_begin<0>(ubrr, doubleSpeed);
+#endif
+#if DEBUG_PORT_USED(1)
+    debug_port_begin<1>(ubrr, doubleSpeed);
+#endif
+#if DEBUG_PORT_USED(2)
+    debug_port_begin<2>(ubrr, doubleSpeed);
+#endif
+#if DEBUG_PORT_USED(3)
+    debug_port_begin<3>(ubrr, doubleSpeed);
+#endif
+    debugPanicMode = false;
+    debugStatsReset();
+#if DEBUG_TIMER1_USED
+    debug_timer1_begin();
+#endif
+#if DEBUG_PROFILE
+    debugProfileReset();
+#endif
+    sei();
+}
+
+// -----------------------------------------------------------------------------------
+// UART initialization procedure
+// -----------------------------------------------------------------------------------
+// Input : int32_t debugBaud - The desired baud rate (e.g., 9600, 115200)
+// Output: void
+// Runtime version of debugSerialBegin<baud>(): always uses double-speed mode (U2X) and
+// computes the divisor from F_CPU with a 32-bit division, without any error check.
+// -----------------------------------------------------------------------------------
+void debugSerialBegin(int32_t debugBaud) {
+    debugSerialBeginUbrr((uint16_t)((F_CPU / (8UL * debugBaud)) - 1), true);
+}
+
+// -----------------------------------------------------------------------------------
+// Timestamp procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: uint32_t - Ticks since debugSerialBegin (0 if built without DEBUG_TIMESTAMP)
+// The clock the line stamps use: DEBUG_TIMESTAMP_SOURCE() when defined, otherwise
+// TCNT1 extended to 32 bits by the overflow count of TIMER1_OVF_vect. An overflow
+// that happened while interrupts were masked is still pending in TOV1; it is counted
+// if TCNT1 was read after it, i.e. read back small. About 20 cycles with the call.
+// Handy for measuring loop jitter with the same clock as the log.
+// -----------------------------------------------------------------------------------
+uint32_t debugTimestamp(void) {
+#if DEBUG_TIMESTAMP && defined(DEBUG_TIMESTAMP_SOURCE)
+    return DEBUG_TIMESTAMP_SOURCE();
+#elif DEBUG_TIMESTAMP
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t low = TCNT1;
+    uint16_t high = debugTimestampHigh;
+    if ((TIFR1 & (1 << TOV1)) && !(low & 0x8000)) {
+        high++;
+    }
+    SREG = sreg;
+    return ((uint32_t)high << 16) | low;
+#else
+    return 0;
+#endif
+}
+
+// -----------------------------------------------------------------------------------
+// Text channel selection procedure
+// -----------------------------------------------------------------------------------
+// Input : uint8_t channel - DEBUG_CHANNEL_TEXT, DEBUG_CHANNEL_FAULT or
+//                           DEBUG_CHANNEL_TELEMETRY
+// Output: uint8_t - The previously selected channel
+// Routes the print functions, debugLog and token records to the given channel until
+// the next call. A channel the build does not enable selects DEBUG_CHANNEL_TEXT.
+// -----------------------------------------------------------------------------------
+uint8_t debugChannelSelect(uint8_t channel) {
+#if (DEBUG_TELEMETRY_BUFFER_SIZE > 0) || (DEBUG_FAULT_BUFFER_SIZE > 0)
+    uint8_t previous = debugSelectedChannel;
+    if (!DEBUG_FAULT_BUFFER_SIZE && channel == DEBUG_CHANNEL_FAULT) {
+        channel = DEBUG_CHANNEL_TEXT;
+    }
+    if (!DEBUG_TELEMETRY_BUFFER_SIZE && channel == DEBUG_CHANNEL_TELEMETRY) {
+        channel = DEBUG_CHANNEL_TEXT;
+    }
+    debugSelectedChannel = (channel > DEBUG_CHANNEL_FAULT) ? DEBUG_CHANNEL_TEXT : channel;
+    return previous;
+#else
+    (void)channel;
+    return DEBUG_CHANNEL_TEXT;
+#endif
+}
+
+// -----------------------------------------------------------------------------------
+// Channel queued bytes procedure
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Output: uint8_t - Number of bytes in the channel's ring buffer
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static inline uint8_t debug_channel_pending(void) {
+    return debugChannel<C>::usable - debug_buffer_space(&debugChannel<C>::buffer);
+}
+
+// -----------------------------------------------------------------------------------
+// Queued bytes procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: uint16_t - Number of bytes waiting in the ring buffers of all channels
+// Bytes already handed to a USART (at most two per USART: UDRn and the shift register)
+// are not counted; debugFlush waits for those too.
+// -----------------------------------------------------------------------------------
+uint16_t debugPending(void) {
+    uint16_t pending = debug_channel_pending<DEBUG_CHANNEL_TEXT>();
+#if DEBUG_TELEMETRY_BUFFER_SIZE > 0
+    pending += debug_channel_pending<DEBUG_CHANNEL_TELEMETRY>();
+#endif
+#if DEBUG_FAULT_BUFFER_SIZE > 0
+    pending += debug_channel_pending<DEBUG_CHANNEL_FAULT>();
+#endif
+    return pending;
+}
+
+#if DEBUG_STATS
+// -----------------------------------------------------------------------------------
+// Channel statistics copy procedure (DEBUG_STATS)
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Input : debugStats_t *stats - Receives the counters
+// Output: void
+// Called with interrupts masked.
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static void debug_stats_copy(debugStats_t *stats) {
+    *stats = debugChannel<C>::stats;
+    stats->interrupts = debugPort<debugChannel<C>::usart>::interrupts;
+}
+
+// -----------------------------------------------------------------------------------
+// Channel statistics reset procedure (DEBUG_STATS)
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Output: void
+// Called with interrupts masked.
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static void debug_stats_clear(void) {
+    memset(&debugChannel<C>::stats, 0, sizeof(debugStats_t));
+    debugPort<debugChannel<C>::usart>::interrupts = 0;
+}
+#endif
+
+// -----------------------------------------------------------------------------------
+// Statistics read procedure
+// -----------------------------------------------------------------------------------
+// Input : uint8_t channel - DEBUG_CHANNEL_TEXT, DEBUG_CHANNEL_TELEMETRY or
+//                           DEBUG_CHANNEL_FAULT
+// Input : debugStats_t *stats - Receives the counters
+// Output: bool - Returns false, with all counters zero, if built without DEBUG_STATS
+// Copies the channel's counters since debugSerialBegin or debugStatsReset with
+// interrupts masked, so the snapshot is consistent. A channel the build does not enable
+// reports the text channel, which carries its output. The interrupt count is that of
+// the channel's USART, shared with the other channels on it. The counters wrap at 2^32.
+// -----------------------------------------------------------------------------------
+bool debugStatsGet(uint8_t channel, debugStats_t *stats) {
+#if DEBUG_STATS
+    uint8_t sreg = SREG;
+    cli();
+#if DEBUG_FAULT_BUFFER_SIZE > 0
+    if (channel == DEBUG_CHANNEL_FAULT) {
+        debug_stats_copy<DEBUG_CHANNEL_FAULT>(stats);
+        SREG = sreg;
+        return true;
+    }
+#endif
+#if DEBUG_TELEMETRY_BUFFER_SIZE > 0
+    if (channel == DEBUG_CHANNEL_TELEMETRY) {
+        debug_stats_copy<DEBUG_CHANNEL_TELEMETRY>(stats);
+        SREG = sreg;
+        return true;
+    }
+#endif
+    (void)channel;
+    debug_stats_copy<DEBUG_CHANNEL_TEXT>(stats);
+    SREG = sreg;
+    return true;
+#else
+    (void)channel;
+    memset(stats, 0, sizeof(*stats));
+    return false;
+#endif
+}
+
+// -----------------------------------------------------------------------------------
+// Statistics reset procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: void
+// Zeroes the counters of every channel, e.g. at the start of a measurement window.
+// debugSerialBegin does the same.
+// -----------------------------------------------------------------------------------
+void debugStatsReset(void) {
+#if DEBUG_STATS
+    uint8_t sreg = SREG;
+    cli();
+    debug_stats_clear<DEBUG_CHANNEL_TEXT>();
+#if DEBUG_TELEMETRY_BUFFER_SIZE > 0
+    debug_stats_clear<DEBUG_CHANNEL_TELEMETRY>();
+#endif
+#if DEBUG_FAULT_BUFFER_SIZE > 0
+    debug_stats_clear<DEBUG_CHANNEL_FAULT>();
+#endif
+    SREG = sreg;
+#endif
+}
+
+// -----------------------------------------------------------------------------------
+// USART drained test procedure
+// -----------------------------------------------------------------------------------
+// Template: uint8_t N - USART number
+// Output: bool - Returns true once USART N has nothing queued and its last stop bit is out
+// The UDRE interrupt disables itself only when all of the port's channels are empty,
+// and TXCn is cleared after every byte it sends, so UDRIEn clear plus TXCn set means
+// the line is idle. If global interrupts are disabled the ISR cannot run, so the
+// caller moves the bytes itself, as BLOCK writers do.
+// -----------------------------------------------------------------------------------
+template <uint8_t N>
+static bool debug_port_drained(void) {
+    typedef debugUsart<N> usart;
+    if (!(SREG & (1 << SREG_I)) && (usart::ucsra() & (1 << usart::udre))) {
+        debug_port_service<N>();
+    }
+    return !(usart::ucsrb() & (1 << usart::udrie)) &&
+           (!debugPort<N>::active || (usart::ucsra() & (1 << usart::txc)));
+}
+
+// -----------------------------------------------------------------------------------
+// All USARTs drained test procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: bool - Returns true once every USART a channel uses is idle
+// -----------------------------------------------------------------------------------
+static bool debug_drained(void) {
+    bool drained = true;
+#if DEBUG_PORT_USED(0)
+    drained &= debug_port_drained<0>();
+#endif
+#if DEBUG_PORT_USED(1)
+    drained &= debug_port_drained<1>();
+#endif
+#if DEBUG_PORT_USED(2)
+    drained &= debug_port_drained<2>();
+#endif
+#if DEBUG_PORT_USED(3)
+    drained &= debug_port_drained<3>();
+#endif
+    return drained;
+}
+
+// -----------------------------------------------------------------------------------
+// Profile read procedure
+// -----------------------------------------------------------------------------------
+// Input : uint8_t slot - Profile slot (DEBUG_PROFILE_ISR to DEBUG_PROFILE_EVENTS)
+// Input : debugProfile_t *profile - Receives the slot's timing
+// Output: bool - Returns false, with all fields zero, for an unknown slot or if built
+//                without DEBUG_PROFILE
+// Copies the slot's timing since debugSerialBegin or debugProfileReset with interrupts
+// masked, so the snapshot is consistent.
+// -----------------------------------------------------------------------------------
+bool debugProfileGet(uint8_t slot, debugProfile_t *profile) {
+#if DEBUG_PROFILE
+    if (slot < DEBUG_PROFILE_SLOTS) {
+        uint8_t sreg = SREG;
+        cli();
+        *profile = debugProfileTable[slot];
+        SREG = sreg;
+        return true;
+    }
+#else
+    (void)slot;
+#endif
+    memset(profile, 0, sizeof(*profile));
+    return false;
+}
+
+// -----------------------------------------------------------------------------------
+// Profile reset procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: void
+// Clears every slot and measures the cost of an empty timed call, which is then
+// subtracted from each measurement. Both run with interrupts masked. debugSerialBegin
+// does the same.
+// -----------------------------------------------------------------------------------
+void debugProfileReset(void) {
+#if DEBUG_PROFILE
+    uint8_t sreg = SREG;
+    cli();
+    for (uint8_t slot = 0; slot < DEBUG_PROFILE_SLOTS; slot++) {
+        memset(&debugProfileTable[slot], 0, sizeof(debugProfile_t));
+        debugProfileTable[slot].min = 0xFFFF;
+    }
+    uint8_t depth = debugProfileDepth;
+    debugProfileDepth = 0;
+    {
+        debugProfileScope calibrate(DEBUG_PROFILE_SLOTS);
+    }
+    debugProfileDepth = depth;
+    SREG = sreg;
+#endif
+}
+
+// -----------------------------------------------------------------------------------
+// Profile dump procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: void
+// Prints one line per slot that was called, through the selected channel:
+//   slot                 calls    min    max      avg
+//   debugPrintInt           12    402    519      431
+// Each line is flushed before the next, so the table arrives whole under any overflow
+// policy as long as the ring buffer holds one line (51 bytes). The dump's own output
+// is not timed. Durations are 16-bit: a call longer than 65535 cycles (4 ms at 16 MHz)
+// wraps and is reported short.
+// -----------------------------------------------------------------------------------
+void debugProfileDump(void) {
+#if DEBUG_PROFILE
+    static const char header[] PROGMEM = "slot                 calls    min    max      avg";
+    static const char names[DEBUG_PROFILE_SLOTS][18] PROGMEM = {
+        "UDRE ISR", "uart1_print_char", "debugWrite", "debugPrint", "debugPrintInt",
+        "debugPrintInt64", "debugPrintFloat", "debugPrintFixed", "debugPrintHex",
+        "debugHexDump", "debugLogCommit", "debugTokenCommit", "debugTelemetry",
+        "debugEventService"
+    };
+    debugProfileDepth++;
+    debugPrintln_P(header);
+    debugFlush();
+    for (uint8_t slot = 0; slot < DEBUG_PROFILE_SLOTS; slot++) {
+        debugProfile_t entry;
+        debugProfileGet(slot, &entry);
+        if (entry.calls == 0) {
+            continue;
+        }
+        debugPrint_P(names[slot]);
+        for (uint8_t pad = (uint8_t)strlen_P(names[slot]); pad < 17; pad++) {
+            uart1_print_char(' ');
+        }
+        debugPrintUIntPadded(entry.calls, 9, ' ');
+        debugPrintUIntPadded(entry.min, 7, ' ');
+        debugPrintUIntPadded(entry.max, 7, ' ');
+        debugPrintUIntPadded(entry.total / entry.calls, 9, ' ');
+        debugWrite("\r\n", 2);
+        debugFlush();
+    }
+    debugProfileDepth--;
+#endif
+}
+
+// -----------------------------------------------------------------------------------
+// Flush procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: void
+// Waits until every queued byte has left the TX pin: all ring buffers empty and the
+// transmit-complete flag (TXCn) set on every USART in use. Call it before a reset,
+// before letting the watchdog expire, and before sleep modes that stop the USART clock.
+// Works with global interrupts disabled.
+// -----------------------------------------------------------------------------------
+void debugFlush(void) {
+    while (!debug_drained()) {
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Flush with timeout procedure
+// -----------------------------------------------------------------------------------
+// Input : uint32_t cycles - Longest time to wait, in CPU cycles
+// Output: bool - Returns true if everything was sent, false on timeout
+// As debugFlush, but gives up after about the given number of cycles. The wait is
+// measured with _delay_loop_2 steps of DEBUG_FLUSH_POLL_CYCLES, so the real time can
+// exceed it by the cost of the checks (a few tens of cycles per step).
+// debugFlushTimeout(0) just reports whether the transmitter is idle, e.g. to decide
+// whether the CPU may sleep right away.
+// -----------------------------------------------------------------------------------
+bool debugFlushTimeout(uint32_t cycles) {
+    while (!debug_drained()) {
+        if (cycles < DEBUG_FLUSH_POLL_CYCLES) {
+            return false;
+        }
+        _delay_loop_2(DEBUG_FLUSH_POLL_CYCLES / 4);
+        cycles -= DEBUG_FLUSH_POLL_CYCLES;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// Panic mode entry procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: void
+// For fault handlers and crash dumps, where interrupts may be disabled and the UDRE
+// interrupt will never run again. Sends everything already queued on every channel,
+// by polling UDREn in the usual priority order, and from then on makes all output
+// (print functions, debugLog, records, telemetry) synchronous: each call returns once
+// its last byte is in UDRn. Queued debugEvent records are printed after the text.
+// Never reads or changes the global interrupt flag, so it is safe with interrupts in
+// any state and inside an ISR. Panic mode lasts until the next debugSerialBegin. Call
+// debugFlush before a reset so the last byte is not cut off.
+// -----------------------------------------------------------------------------------
+void debugPanicBegin(void) {
+    debugPanicMode = true;
+#if DEBUG_PORT_USED(0)
+    debug_port_drain<0>();
+#endif
+#if DEBUG_PORT_USED(1)
+    debug_port_drain<1>();
+#endif
+#if DEBUG_PORT_USED(2)
+    debug_port_drain<2>();
+#endif
+#if DEBUG_PORT_USED(3)
+    debug_port_drain<3>();
+#endif
+    debugEventService();
+}
+
+// -----------------------------------------------------------------------------------
+// UART1 single character transmission procedure
+// -----------------------------------------------------------------------------------
+// Input : char data - The character to transmit via UART1
+// Output: void
+// Adds the character to the ring buffer and enables the UART1 data register empty
+// interrupt (UDRIE1). The producer writes the head index and USART1_UDRE_vect the
+// tail, both single bytes, so each side sees a consistent value; with DEBUG_ISR_SAFE
+// the insertion is a short critical section so ISRs may print too. UDRIE1 is set
+// after the head is published, so the ISR can never disable itself while data is pending.
+// The name is historical: the character goes to the selected channel (DEBUG_USART).
+// -----------------------------------------------------------------------------------
+void uart1_print_char(char data) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_CHAR);
+#if (DEBUG_TELEMETRY_BUFFER_SIZE > 0) || (DEBUG_FAULT_BUFFER_SIZE > 0)
+    if (debugSelectedChannel != DEBUG_CHANNEL_TEXT) {
+        debug_text_write(&data, 1, false);
+        return;
+    }
+#endif
+#if DEBUG_TIMESTAMP
+    if (debugChannel<DEBUG_CHANNEL_TEXT>::lineStart || data == '\n') {
+        debug_text_write(&data, 1, false);
+        return;
+    }
+#endif
+    if (debugPanicMode) {
+        debug_panic_write<DEBUG_CHANNEL_TEXT>(&data, 1, false);
+        return;
+    }
+    debug_buffer_put<DEBUG_CHANNEL_TEXT>(data);
+    debug_channel_kick<DEBUG_CHANNEL_TEXT>();
+}
+
+// -----------------------------------------------------------------------------------
+// UART1 bulk transmission procedure
+// -----------------------------------------------------------------------------------
+// Input : const char *data - Pointer to the bytes to transmit (need not be terminated)
+// Input : uint8_t len - Number of bytes to transmit
+// Output: void
+// Copies the whole block into the ring buffer with a single head update and enables
+// the UART1 data register empty interrupt (UDRIE1) once, instead of paying the register
+// update per character. Bytes that do not fit are dropped.
+// -----------------------------------------------------------------------------------
+void debugWrite(const char *data, uint8_t len) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_WRITE);
+    debug_text_write(data, len, false);
+}
+
+// -----------------------------------------------------------------------------------
+// UART1 bulk transmission from flash procedure
+// -----------------------------------------------------------------------------------
+// Input : const char *data - Pointer to the bytes to transmit, in program memory
+// Input : uint8_t len - Number of bytes to transmit
+// Output: void
+// Same as debugWrite, but copies straight from flash into the ring buffer with
+// memcpy_P, so the data never needs an SRAM copy.
+// -----------------------------------------------------------------------------------
+void debugWrite_P(const char *data, uint8_t len) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_WRITE);
+    debug_text_write(data, len, true);
+}
+
+// -----------------------------------------------------------------------------------
+// Binary record transmission procedure
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Input : const uint8_t *data - Pointer to the record
+// Input : uint8_t len - Record length (less than the channel's buffer size)
+// Output: bool - Returns true if the whole record was queued
+// A cut binary record would desynchronise the host tools, so with DROP_NEWEST a record
+// that does not fit is dropped whole (check and copy share one critical section, so
+// no ISR writer can take the space in between); DROP_MESSAGE, MARK and framed output
+// already behave that way.
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static bool debug_write_record(const uint8_t *data, uint8_t len) {
+#if (DEBUG_OVERFLOW_POLICY == DEBUG_OVERFLOW_DROP_NEWEST) && !DEBUG_FRAMING
+    if (!debugPanicMode) {
+        debugCritical critical;     // Keeps ISR writers out between the check and the copy
+        if (debug_buffer_space(&debugChannel<C>::buffer) < len) {
+            debug_stats_dropped<C>(len);
+            return false;
+        }
+        return debug_channel_write<C>((const char *)data, len, false) == len;
+    }
+#endif
+    return debug_channel_write<C>((const char *)data, len, false) == len;
+}
+
+// -----------------------------------------------------------------------------------
+// Line terminator printing procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: void
+// Appends a carriage return ('\r') and newline ('\n') to the ring buffer in one write.
+// -----------------------------------------------------------------------------------
+static void debug_print_newline(void) {
+    debugWrite("\r\n", 2);
+}
+
+// -----------------------------------------------------------------------------------
+// String printing procedure
+// -----------------------------------------------------------------------------------
+// Input : const char *str - Pointer to a null-terminated string to transmit
+// Output: void
+// Measures the string and hands it to debugWrite, splitting strings longer than 255
+// characters into several bulk writes.
+// -----------------------------------------------------------------------------------
+void debugPrint(const char *str) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_PRINT);
+    size_t len = strlen(str);
+    while (len > 0) {
+        uint8_t chunk = (len > 255) ? 255 : (uint8_t)len;
+        debugWrite(str, chunk);
+        str += chunk;
+        len -= chunk;
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// String printing with newline procedure
+// -----------------------------------------------------------------------------------
+// Input : const char *str - Pointer to a null-terminated string to transmit
+// Output: void
+// Prints the string using debugPrint, then appends a carriage return ('\r') and
+// newline ('\n') to the ring buffer for transmission, simulating a line break.
+// -----------------------------------------------------------------------------------
+void debugPrintln(const char *str) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_PRINT);
+    debugPrint(str);
+    debug_print_newline();
+}
+
+// -----------------------------------------------------------------------------------
+// Flash string printing procedure
+// -----------------------------------------------------------------------------------
+// Input : const char *str - Pointer to a null-terminated string in program memory,
+//                           e.g. DEBUG_STR("text") or a PROGMEM array
+// Output: void
+// Measures the string with strlen_P and streams it from flash into the ring buffer
+// with debugWrite_P, splitting strings longer than 255 characters.
+// -----------------------------------------------------------------------------------
+void debugPrint_P(const char *str) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_PRINT);
+    size_t len = strlen_P(str);
+    while (len > 0) {
+        uint8_t chunk = (len > 255) ? 255 : (uint8_t)len;
+        debugWrite_P(str, chunk);
+        str += chunk;
+        len -= chunk;
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Flash string printing with newline procedure
+// -----------------------------------------------------------------------------------
+// Input : const char *str - Pointer to a null-terminated string in program memory
+// Output: void
+// Prints the string using debugPrint_P, then appends a carriage return ('\r') and
+// newline ('\n').
+// -----------------------------------------------------------------------------------
+void debugPrintln_P(const char *str) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_PRINT);
+    debugPrint_P(str);
+    debug_print_newline();
+}
+
+// -----------------------------------------------------------------------------------
+// Padded number queuing procedure
+// -----------------------------------------------------------------------------------
+// Input : const char *digits - Decimal digits of the magnitude, most significant first
+// Input : uint8_t digitCount - Number of digits
+// Input : bool negative - Prefix a minus sign
+// Input : uint8_t width - Minimum field width including the sign (0 = no padding);
+//                         values above DEBUG_NUMBER_MAX_WIDTH are clamped
+// Input : char fill - Padding character; '0' pads after the sign ("-0042"), any other
+//                     character pads before it ("  -42")
+// Output: void
+// Assembles sign, padding and digits into one field and queues it with one debugWrite.
+// -----------------------------------------------------------------------------------
+static void debug_print_field(const char *digits, uint8_t digitCount, bool negative,
+                              uint8_t width, char fill) {
+    char text[DEBUG_NUMBER_MAX_WIDTH];
+    uint8_t len = digitCount + (negative ? 1 : 0);
+    if (width > DEBUG_NUMBER_MAX_WIDTH) {
+        width = DEBUG_NUMBER_MAX_WIDTH;
+    }
+    uint8_t padding = (width > len) ? width - len : 0;
+
+    uint8_t pos = 0;
+    if (negative && fill == '0') {
+        text[pos++] = '-';
+    }
+    memset(&text[pos], fill, padding);
+    pos += padding;
+    if (negative && fill != '0') {
+        text[pos++] = '-';
+    }
+    memcpy(&text[pos], digits, digitCount);
+    debugWrite(text, pos + digitCount);
+}
+
+// -----------------------------------------------------------------------------------
+// Padded integer printing procedure
+// -----------------------------------------------------------------------------------
+// Input : int32_t value - The 32-bit integer to transmit
+// Input : uint8_t width - Minimum field width including the sign (0 = no padding)
+// Input : char fill - Padding character (' ' or '0')
+// Output: void
+// Formats the unsigned magnitude (so INT32_MIN is exact) with the division-free digit
+// engine and queues sign, padding and digits as a single write.
+// -----------------------------------------------------------------------------------
+void debugPrintIntPadded(int32_t value, uint8_t width, char fill) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_INT);
+    char digits[10];
+    uint32_t magnitude = (uint32_t)value;
+    if (value < 0) {
+        magnitude = 0UL - magnitude;
+    }
+    uint8_t count = debug_format_uint32(digits, magnitude, 1);
+    debug_print_field(digits, count, value < 0, width, fill);
+}
+
+// -----------------------------------------------------------------------------------
+// Padded unsigned integer printing procedure
+// -----------------------------------------------------------------------------------
+// Input : uint32_t value - The 32-bit unsigned integer to transmit
+// Input : uint8_t width - Minimum field width (0 = no padding)
+// Input : char fill - Padding character (' ' or '0')
+// Output: void
+// -----------------------------------------------------------------------------------
+void debugPrintUIntPadded(uint32_t value, uint8_t width, char fill) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_INT);
+    char digits[10];
+    uint8_t count = debug_format_uint32(digits, value, 1);
+    debug_print_field(digits, count, false, width, fill);
+}
+
+// -----------------------------------------------------------------------------------
+// Padded 64-bit integer printing procedure
+// -----------------------------------------------------------------------------------
+// Input : int64_t value - The 64-bit integer to transmit
+// Input : uint8_t width - Minimum field width including the sign (0 = no padding)
+// Input : char fill - Padding character (' ' or '0')
+// Output: void
+// -----------------------------------------------------------------------------------
+void debugPrintInt64Padded(int64_t value, uint8_t width, char fill) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_INT64);
+    char digits[20];
+    uint64_t magnitude = (uint64_t)value;
+    if (value < 0) {
+        magnitude = 0ULL - magnitude;
+    }
+    uint8_t count = debug_format_uint64(digits, magnitude);
+    debug_print_field(digits, count, value < 0, width, fill);
+}
+
+// -----------------------------------------------------------------------------------
+// Padded 64-bit unsigned integer printing procedure
+// -----------------------------------------------------------------------------------
+// Input : uint64_t value - The 64-bit unsigned integer to transmit
+// Input : uint8_t width - Minimum field width (0 = no padding)
+// Input : char fill - Padding character (' ' or '0')
+// Output: void
+// -----------------------------------------------------------------------------------
+void debugPrintUInt64Padded(uint64_t value, uint8_t width, char fill) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_INT64);
+    char digits[20];
+    uint8_t count = debug_format_uint64(digits, value);
+    debug_print_field(digits, count, false, width, fill);
+}
+
+// -----------------------------------------------------------------------------------
+// Integer printing procedure
+// -----------------------------------------------------------------------------------
+// Input : int32_t value - The 32-bit integer to transmit
+// Output: void
+// Converts the integer to its decimal representation with the division-free digit
+// engine (debug_format_uint32). Negative numbers get a minus sign and are formatted
+// from their unsigned magnitude, so INT32_MIN prints correctly. The complete number
+// is queued with one debugWrite.
+// -----------------------------------------------------------------------------------
+void debugPrintInt(int32_t value) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_INT);
+    debugPrintIntPadded(value, 0, ' ');
+}
+
+// -----------------------------------------------------------------------------------
+// Integer printing with newline procedure
+// -----------------------------------------------------------------------------------
+// Input : int32_t value - The 32-bit integer to transmit
+// Output: void
+// Prints the integer using debugPrintInt, then appends a carriage return ('\r') and
+// newline ('\n') to the ring buffer for transmission, simulating a line break.
+// -----------------------------------------------------------------------------------
+void debugPrintIntln(int32_t value) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_INT);
+    debugPrintInt(value);
+    debug_print_newline();
+}
+
+// -----------------------------------------------------------------------------------
+// Unsigned integer printing procedure
+// -----------------------------------------------------------------------------------
+// Input : uint32_t value - The 32-bit unsigned integer to transmit (e.g. a counter)
+// Output: void
+// -----------------------------------------------------------------------------------
+void debugPrintUInt(uint32_t value) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_INT);
+    debugPrintUIntPadded(value, 0, ' ');
+}
+
+// -----------------------------------------------------------------------------------
+// Unsigned integer printing with newline procedure
+// -----------------------------------------------------------------------------------
+// Input : uint32_t value - The 32-bit unsigned integer to transmit
+// Output: void
+// -----------------------------------------------------------------------------------
+void debugPrintUIntln(uint32_t value) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_INT);
+    debugPrintUInt(value);
+    debug_print_newline();
+}
+
+// -----------------------------------------------------------------------------------
+// 64-bit integer printing procedure
+// -----------------------------------------------------------------------------------
+// Input : int64_t value - The 64-bit integer to transmit
+// Output: void
+// -----------------------------------------------------------------------------------
+void debugPrintInt64(int64_t value) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_INT64);
+    debugPrintInt64Padded(value, 0, ' ');
+}
+
+// -----------------------------------------------------------------------------------
+// 64-bit integer printing with newline procedure
+// -----------------------------------------------------------------------------------
+// Input : int64_t value - The 64-bit integer to transmit
+// Output: void
+// -----------------------------------------------------------------------------------
+void debugPrintInt64ln(int64_t value) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_INT64);
+    debugPrintInt64(value);
+    debug_print_newline();
+}
+
+// -----------------------------------------------------------------------------------
+// 64-bit unsigned integer printing procedure
+// -----------------------------------------------------------------------------------
+// Input : uint64_t value - The 64-bit unsigned integer to transmit (e.g. a timestamp)
+// Output: void
+// -----------------------------------------------------------------------------------
+void debugPrintUInt64(uint64_t value) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_INT64);
+    debugPrintUInt64Padded(value, 0, ' ');
+}
+
+// -----------------------------------------------------------------------------------
+// 64-bit unsigned integer printing with newline procedure
+// -----------------------------------------------------------------------------------
+// Input : uint64_t value - The 64-bit unsigned integer to transmit
+// Output: void
+// -----------------------------------------------------------------------------------
+void debugPrintUInt64ln(uint64_t value) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_INT64);
+    debugPrintUInt64(value);
+    debug_print_newline();
+}
+
+// -----------------------------------------------------------------------------------
+// Scaled decimal formatting procedure
+// -----------------------------------------------------------------------------------
+// Input : char *out - Destination (at least DEBUG_DECIMAL_MAX_WIDTH bytes, not terminated)
+// Input : uint64_t scaled - Magnitude multiplied by 10^decimals and already rounded
+// Input : bool negative - Prefix a minus sign (suppressed when scaled is zero)
+// Input : uint8_t decimals - Number of digits after the decimal point (at most 9)
+// Output: uint8_t - Number of characters written
+// Formats the scaled integer with at least decimals + 1 digits and inserts the decimal
+// point before the last decimals digits. No division is needed to split integer and
+// fractional parts.
+// -----------------------------------------------------------------------------------
+static uint8_t debug_format_scaled(char *out, uint64_t scaled, bool negative, uint8_t decimals) {
+    char digits[20];
+    uint8_t count;
+    if ((scaled >> 32) == 0) {
+        count = debug_format_uint32(digits, (uint32_t)scaled, decimals + 1);
+    } else {
+        count = debug_format_uint64(digits, scaled);
+    }
+
+    uint8_t pos = 0;
+    if (negative && scaled != 0) {
+        out[pos++] = '-';
+    }
+    uint8_t intDigits = count - decimals;
+    memcpy(&out[pos], digits, intDigits);
+    pos += intDigits;
+    if (decimals > 0) {
+        out[pos++] = '.';
+        memcpy(&out[pos], &digits[intDigits], decimals);
+        pos += decimals;
+    }
+    return pos;
+}
+
+// -----------------------------------------------------------------------------------
+// Floating-point formatting procedure
+// -----------------------------------------------------------------------------------
+// Input : char *out - Destination (at least DEBUG_DECIMAL_MAX_WIDTH bytes, not terminated)
+// Input : float value - The floating-point number to format
+// Input : uint8_t decimals - Number of decimal places (clamped to DEBUG_FLOAT_MAX_DECIMALS)
+// Output: uint8_t - Number of characters written
+// Produces "nan", "inf" or "-inf" for non-finite values. Otherwise takes the integer
+// part exactly, scales only the fraction by 10^decimals, adds 0.5 to round to nearest
+// and combines the two into one integer (a rounded-up fraction carries into the
+// integer part), which debug_format_scaled turns into digits with the decimal point
+// inserted. Scaling the whole value instead would round it to 24 bits and change
+// digits the float holds (20000.123 would print as 20000.124). This costs one
+// soft-float subtract, multiply, add and two conversions instead of a multiply,
+// conversion and subtract per decimal place, and rounds the last digit instead of
+// truncating it. Results beyond the 64-bit range (magnitude x 10^decimals) give "ovf".
+// -----------------------------------------------------------------------------------
+static uint8_t debug_format_float(char *out, float value, uint8_t decimals) {
+    if (isnan(value)) {
+        memcpy_P(out, PSTR("nan"), 3);
+        return 3;
+    }
+    bool negative = value < 0;
+    if (negative) {
+        value = -value;
+    }
+    if (isinf(value)) {
+        if (negative) {
+            memcpy_P(out, PSTR("-inf"), 4);
+            return 4;
+        }
+        memcpy_P(out, PSTR("inf"), 3);
+        return 3;
+    }
+    if (decimals > DEBUG_FLOAT_MAX_DECIMALS) {
+        decimals = DEBUG_FLOAT_MAX_DECIMALS;
+    }
+
+    float scale = pgm_read_float(&debugFloatPow10[decimals]);
+    if (value * scale >= 18446744073709551616.0f) {
+        memcpy_P(out, PSTR("ovf"), 3);
+        return 3;
+    }
+    uint32_t power = (decimals > 0) ? pgm_read_dword(&debugPow10[9 - decimals]) : 1;
+    if (value < 4294967296.0f) {
+        uint32_t intPart = (uint32_t)value;
+        uint32_t fraction = (uint32_t)((value - (float)intPart) * scale + 0.5f);
+        if (intPart < (1UL << (32 - pgm_read_byte(&debugPow10Bits[decimals])))) {
+            return debug_format_scaled(out, intPart * power + fraction, negative, decimals);
+        }
+        return debug_format_scaled(out, (uint64_t)intPart * power + fraction, negative, decimals);
+    }
+    return debug_format_scaled(out, (uint64_t)value * power, negative, decimals);  // No fraction left
+}
+
+// -----------------------------------------------------------------------------------
+// Floating-point number printing procedure
+// -----------------------------------------------------------------------------------
+// Input : float value - The floating-point number to transmit
+// Input : uint8_t decimalPlaces - Number of decimal places to display (0 to
+//                                 DEBUG_FLOAT_MAX_DECIMALS, larger values are clamped)
+// Output: void
+// Formats the value with debug_format_float (one fixed-point conversion with rounding,
+// "nan"/"inf"/"-inf"/"ovf" for values that have no digits) and queues it with one write.
+// -----------------------------------------------------------------------------------
+void debugPrintFloat(float value, uint8_t decimalPlaces) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_FLOAT);
+    char text[DEBUG_DECIMAL_MAX_WIDTH];
+    debugWrite(text, debug_format_float(text, value, decimalPlaces));
+}
+
+// -----------------------------------------------------------------------------------
+// Floating-point number printing with newline procedure
+// -----------------------------------------------------------------------------------
+// Input : float value - The floating-point number to transmit
+// Input : uint8_t decimalPlaces - Number of decimal places to display (0 or more)
+// Output: void
+// Prints the float using debugPrintFloat, then appends a carriage return ('\r') and
+// newline ('\n') to the ring buffer for transmission, simulating a line break.
+// -----------------------------------------------------------------------------------
+void debugPrintFloatln(float value, uint8_t decimalPlaces) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_FLOAT);
+    debugPrintFloat(value, decimalPlaces);
+    debug_print_newline();
+}
+
+// -----------------------------------------------------------------------------------
+// Fixed-point number printing procedure
+// -----------------------------------------------------------------------------------
+// Input : int32_t raw - Fixed-point value as stored (e.g. a Q15 or Q16.16 integer)
+// Input : uint8_t fracBits - Number of fractional bits in raw (0 to 31)
+// Input : uint8_t decimals - Number of decimal places to display (0 to
+//                            DEBUG_FLOAT_MAX_DECIMALS, larger values are clamped)
+// Output: void
+// Formats the value directly from its integer representation, with no float involved.
+// The fractional bits are scaled by 10^decimals and rounded to nearest (half away from
+// zero) with a shift, then combined with the integer part and printed through the
+// integer engine with the decimal point inserted. 32-bit arithmetic is used whenever
+// the intermediate products fit, which covers the common Q15/Q16.16 cases.
+// -----------------------------------------------------------------------------------
+void debugPrintFixed(int32_t raw, uint8_t fracBits, uint8_t decimals) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_FIXED);
+    if (fracBits > 31) {
+        fracBits = 31;
+    }
+    if (decimals > DEBUG_FLOAT_MAX_DECIMALS) {
+        decimals = DEBUG_FLOAT_MAX_DECIMALS;
+    }
+    uint32_t magnitude = (uint32_t)raw;
+    if (raw < 0) {
+        magnitude = 0UL - magnitude;
+    }
+    uint32_t intPart = magnitude >> fracBits;
+    uint32_t frac = magnitude & ((1UL << fracBits) - 1);
+    uint32_t pow10 = (decimals == 0) ? 1 : pgm_read_dword(&debugPow10[9 - decimals]);
+    uint8_t pow10Bits = pgm_read_byte(&debugPow10Bits[decimals]);
+
+    uint32_t fracScaled = 0;
+    if (fracBits > 0) {
+        uint32_t half = 1UL << (fracBits - 1);
+        if (fracBits + pow10Bits <= 31) {
+            fracScaled = (frac * pow10 + half) >> fracBits;
+        } else {
+            fracScaled = (uint32_t)(((uint64_t)frac * pow10 + half) >> fracBits);
+        }
+    }
+
+    char text[DEBUG_DECIMAL_MAX_WIDTH];
+    uint8_t len;
+    if (intPart < (1UL << (31 - pow10Bits))) {
+        len = debug_format_scaled(text, intPart * pow10 + fracScaled, raw < 0, decimals);
+    } else {
+        len = debug_format_scaled(text, (uint64_t)intPart * pow10 + fracScaled, raw < 0, decimals);
+    }
+    debugWrite(text, len);
+}
+
+// -----------------------------------------------------------------------------------
+// Fixed-point number printing with newline procedure
+// -----------------------------------------------------------------------------------
+// Input : int32_t raw - Fixed-point value as stored
+// Input : uint8_t fracBits - Number of fractional bits in raw (0 to 31)
+// Input : uint8_t decimals - Number of decimal places to display
+// Output: void
+// -----------------------------------------------------------------------------------
+void debugPrintFixedln(int32_t raw, uint8_t fracBits, uint8_t decimals) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_FIXED);
+    debugPrintFixed(raw, fracBits, decimals);
+    debug_print_newline();
+}
+
+// -----------------------------------------------------------------------------------
+// Q-format shorthand printing procedures
+// -----------------------------------------------------------------------------------
+// Input : raw - Q7 (int8_t), Q15 (int16_t) or Q16.16 (int32_t) value
+// Input : uint8_t decimals - Number of decimal places to display
+// Output: void
+// Thin wrappers around debugPrintFixed with the fractional bit count filled in.
+// -----------------------------------------------------------------------------------
+void debugPrintQ7(int8_t raw, uint8_t decimals) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_FIXED);
+    debugPrintFixed(raw, 7, decimals);
+}
+
+void debugPrintQ15(int16_t raw, uint8_t decimals) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_FIXED);
+    debugPrintFixed(raw, 15, decimals);
+}
+
+void debugPrintQ16(int32_t raw, uint8_t decimals) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_FIXED);
+    debugPrintFixed(raw, 16, decimals);
+}
+
+// -----------------------------------------------------------------------------------
+// Hexadecimal printing procedures
+// -----------------------------------------------------------------------------------
+// Input : value - The 8, 16 or 32-bit value to transmit
+// Output: void
+// Print the value as fixed-width upper-case hex (2, 4 or 8 digits, no prefix) with a
+// single write, e.g. debugPrintHex16(0x1F) prints "001F".
+// -----------------------------------------------------------------------------------
+void debugPrintHex8(uint8_t value) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_HEX);
+    char text[2];
+    debug_format_hex(text, value, 2);
+    debugWrite(text, 2);
+}
+
+void debugPrintHex16(uint16_t value) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_HEX);
+    char text[4];
+    debug_format_hex(text, value, 4);
+    debugWrite(text, 4);
+}
+
+void debugPrintHex32(uint32_t value) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_HEX);
+    char text[8];
+    debug_format_hex(text, value, 8);
+    debugWrite(text, 8);
+}
+
+// -----------------------------------------------------------------------------------
+// Binary printing procedure
+// -----------------------------------------------------------------------------------
+// Input : uint32_t value - The value to transmit
+// Input : uint8_t bits - Number of low-order bits to print (1 to 32, clamped)
+// Output: void
+// Prints the bits most significant first as '0'/'1' characters with a single write,
+// e.g. debugPrintBin(0x05, 8) prints "00000101".
+// -----------------------------------------------------------------------------------
+void debugPrintBin(uint32_t value, uint8_t bits) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_HEX);
+    char text[32];
+    if (bits > 32) {
+        bits = 32;
+    }
+    for (uint8_t i = bits; i > 0; i--) {
+        text[i - 1] = '0' + (char)(value & 1);
+        value >>= 1;
+    }
+    debugWrite(text, bits);
+}
+
+// -----------------------------------------------------------------------------------
+// Hex dump procedure
+// -----------------------------------------------------------------------------------
+// Input : const void *data - Pointer to the memory to dump
+// Input : uint16_t len - Number of bytes to dump
+// Output: void
+// Prints the memory 16 bytes per line in the form
+//   "0010: 48 65 6C 6C 6F 00 .. ..  |Hello.          |"
+// i.e. a 4-digit hex offset, the bytes in hex and their printable ASCII (others as
+// '.'). Each line is assembled in a stack buffer with the nibble lookup table and
+// queued with one debugWrite, so a line is never split by the overflow policy.
+// -----------------------------------------------------------------------------------
+void debugHexDump(const void *data, uint16_t len) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_HEX_DUMP);
+    const uint8_t *bytes = (const uint8_t *)data;
+    char line[DEBUG_HEXDUMP_LINE_LENGTH];
+    uint16_t offset = 0;
+
+    while (offset < len) {
+        uint8_t count = (len - offset > 16) ? 16 : (uint8_t)(len - offset);
+        uint8_t pos = 0;
+        debug_format_hex(line, offset, 4);
+        pos = 4;
+        line[pos++] = ':';
+        for (uint8_t i = 0; i < 16; i++) {
+            line[pos++] = ' ';
+            if (i < count) {
+                line[pos++] = pgm_read_byte(&debugHexDigits[bytes[offset + i] >> 4]);
+                line[pos++] = pgm_read_byte(&debugHexDigits[bytes[offset + i] & 0x0F]);
+            } else {
+                line[pos++] = ' ';
+                line[pos++] = ' ';
+            }
+        }
+        line[pos++] = ' ';
+        line[pos++] = ' ';
+        line[pos++] = '|';
+        for (uint8_t i = 0; i < 16; i++) {
+            char c = ' ';
+            if (i < count) {
+                c = (char)bytes[offset + i];
+                if (c < ' ' || c > '~') {
+                    c = '.';
+                }
+            }
+            line[pos++] = c;
+        }
+        line[pos++] = '|';
+        line[pos++] = '\r';
+        line[pos++] = '\n';
+        debugWrite(line, pos);
+        offset += count;
+    }
+}
+
+static int32_t debugTelemetryLast[DEBUG_TELEMETRY_CHANNELS];
+static uint8_t debugTelemetryCountdown[DEBUG_TELEMETRY_CHANNELS];
+
+// -----------------------------------------------------------------------------------
+// Telemetry start procedure
+// -----------------------------------------------------------------------------------
+// Input : uint8_t channels - Number of channels that will be sampled (at most
+//                            DEBUG_TELEMETRY_CHANNELS)
+// Output: void
+// Queues a begin record carrying the channel count, so the host tool starts a new CSV
+// table, and makes the next sample of every channel a full value.
+// -----------------------------------------------------------------------------------
+void debugTelemetryBegin(uint8_t channels) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_TELEMETRY);
+    if (channels > DEBUG_TELEMETRY_CHANNELS) {
+        channels = DEBUG_TELEMETRY_CHANNELS;
+    }
+    memset(debugTelemetryCountdown, 0, sizeof(debugTelemetryCountdown));
+    uint8_t record[3] = { DEBUG_TELEMETRY_START, DEBUG_TELEMETRY_BEGIN, channels };
+    debug_write_record<DEBUG_TELEMETRY_CHANNEL>(record, sizeof(record));
+}
+
+// -----------------------------------------------------------------------------------
+// Telemetry sample procedure
+// -----------------------------------------------------------------------------------
+// Input : uint8_t channel - Channel index (0 to DEBUG_TELEMETRY_CHANNELS - 1)
+// Input : int32_t value - Sample value (scale fractional quantities to fixed point)
+// Output: void
+// Queues one sample record with a single ring buffer write and no decimal formatting.
+// With delta encoding a slowly changing signal costs 3 bytes per sample instead of
+// the 6 of a full record (or up to 13 for debugPrintIntln). A full value is sent after
+// debugTelemetryBegin, every DEBUG_TELEMETRY_KEYFRAME samples, and after a record was
+// dropped, since the host's running total for that channel is then wrong.
+// -----------------------------------------------------------------------------------
+void debugTelemetrySample(uint8_t channel, int32_t value) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_TELEMETRY);
+    if (channel >= DEBUG_TELEMETRY_CHANNELS) {
+        return;
+    }
+    uint8_t record[7];
+    uint8_t len = 2;
+    record[0] = DEBUG_TELEMETRY_START;
+#if DEBUG_TELEMETRY_USE_DELTA
+    if (debugTelemetryCountdown[channel] > 0) {
+        int32_t delta = (int32_t)((uint32_t)value - (uint32_t)debugTelemetryLast[channel]);
+        uint32_t zigzag = ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31);
+        record[1] = channel | DEBUG_TELEMETRY_DELTA;
+        while (zigzag >= 0x80) {
+            record[len++] = (uint8_t)zigzag | 0x80;
+            zigzag >>= 7;
+        }
+        record[len++] = (uint8_t)zigzag;
+#if DEBUG_TELEMETRY_KEYFRAME > 0
+        debugTelemetryCountdown[channel]--;
+#endif
+    } else
+#endif
+    {
+        record[1] = channel;
+        record[len++] = (uint8_t)value;
+        record[len++] = (uint8_t)((uint32_t)value >> 8);
+        record[len++] = (uint8_t)((uint32_t)value >> 16);
+        record[len++] = (uint8_t)((uint32_t)value >> 24);
+        debugTelemetryCountdown[channel] = (DEBUG_TELEMETRY_KEYFRAME > 0) ? DEBUG_TELEMETRY_KEYFRAME - 1 : 1;
+    }
+    if (debug_write_record<DEBUG_TELEMETRY_CHANNEL>(record, len)) {
+        debugTelemetryLast[channel] = value;
+    } else {
+        debugTelemetryCountdown[channel] = 0;
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Log line start procedure
+// -----------------------------------------------------------------------------------
+// Input : debugLogLine_t *line - Line buffer to prepare
+// Output: void
+// Empties the line so items can be appended with the debugLogAppend* functions.
+// -----------------------------------------------------------------------------------
+void debugLogBegin(debugLogLine_t *line) {
+    line->len = 0;
+    line->full = false;
+}
+
+// -----------------------------------------------------------------------------------
+// Log line room check procedure
+// -----------------------------------------------------------------------------------
+// Input : debugLogLine_t *line - Line being assembled
+// Input : uint8_t needed - Worst-case number of characters the next item can produce
+// Output: char * - Where to write the item, or NULL if it does not fit
+// Items that could overflow the line are not formatted; the line is marked full so
+// later items are skipped too and the output is cut cleanly at an item boundary.
+// Two bytes are always held back for the "\r\n" added by debugLogCommit.
+// -----------------------------------------------------------------------------------
+static char *debug_log_room(debugLogLine_t *line, uint8_t needed) {
+    if (line->full || line->len + needed > DEBUG_LOG_LINE_SIZE - 2) {
+        line->full = true;
+        return NULL;
+    }
+    return &line->text[line->len];
+}
+
+// -----------------------------------------------------------------------------------
+// Log line string append procedure
+// -----------------------------------------------------------------------------------
+// Input : debugLogLine_t *line - Line being assembled
+// Input : const char *str - Null-terminated string, in SRAM or flash
+// Input : bool inFlash - str points to program memory (PROGMEM)
+// Output: void
+// Copies as much of the string as fits in the line; a cut string marks the line full.
+// -----------------------------------------------------------------------------------
+void debugLogAppendString(debugLogLine_t *line, const char *str, bool inFlash) {
+    if (line->full) {
+        return;
+    }
+    size_t len = inFlash ? strlen_P(str) : strlen(str);
+    uint8_t room = (DEBUG_LOG_LINE_SIZE - 2) - line->len;
+    if (len > room) {
+        len = room;
+        line->full = true;
+    }
+    if (inFlash) {
+        memcpy_P(&line->text[line->len], str, len);
+    } else {
+        memcpy(&line->text[line->len], str, len);
+    }
+    line->len += (uint8_t)len;
+}
+
+// -----------------------------------------------------------------------------------
+// Log line character append procedure
+// -----------------------------------------------------------------------------------
+// Input : debugLogLine_t *line - Line being assembled
+// Input : char c - Character to append
+// Output: void
+// -----------------------------------------------------------------------------------
+void debugLogAppendChar(debugLogLine_t *line, char c) {
+    char *out = debug_log_room(line, 1);
+    if (out) {
+        *out = c;
+        line->len++;
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Log line number append procedures
+// -----------------------------------------------------------------------------------
+// Input : debugLogLine_t *line - Line being assembled
+// Input : value - Number to append (plus decimals / digits where applicable)
+// Output: void
+// Format the number in place with the same engines as the debugPrint* functions.
+// -----------------------------------------------------------------------------------
+void debugLogAppendInt(debugLogLine_t *line, int32_t value) {
+    char *out = debug_log_room(line, 11);
+    if (out) {
+        uint8_t len = 0;
+        uint32_t magnitude = (uint32_t)value;
+        if (value < 0) {
+            out[len++] = '-';
+            magnitude = 0UL - magnitude;
+        }
+        line->len += len + debug_format_uint32(&out[len], magnitude, 1);
+    }
+}
+
+void debugLogAppendUInt(debugLogLine_t *line, uint32_t value) {
+    char *out = debug_log_room(line, 10);
+    if (out) {
+        line->len += debug_format_uint32(out, value, 1);
+    }
+}
+
+void debugLogAppendInt64(debugLogLine_t *line, int64_t value) {
+    char *out = debug_log_room(line, 20);
+    if (out) {
+        uint8_t len = 0;
+        uint64_t magnitude = (uint64_t)value;
+        if (value < 0) {
+            out[len++] = '-';
+            magnitude = 0ULL - magnitude;
+        }
+        line->len += len + debug_format_uint64(&out[len], magnitude);
+    }
+}
+
+void debugLogAppendUInt64(debugLogLine_t *line, uint64_t value) {
+    char *out = debug_log_room(line, 20);
+    if (out) {
+        line->len += debug_format_uint64(out, value);
+    }
+}
+
+void debugLogAppendFloat(debugLogLine_t *line, float value, uint8_t decimals) {
+    char *out = debug_log_room(line, DEBUG_DECIMAL_MAX_WIDTH);
+    if (out) {
+        line->len += debug_format_float(out, value, decimals);
+    }
+}
+
+void debugLogAppendHex(debugLogLine_t *line, uint32_t value, uint8_t digits) {
+    if (digits < 1 || digits > 8) {
+        digits = 8;
+    }
+    char *out = debug_log_room(line, digits);
+    if (out) {
+        debug_format_hex(out, value, digits);
+        line->len += digits;
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Log line commit procedure
+// -----------------------------------------------------------------------------------
+// Input : debugLogLine_t *line - Completed line
+// Output: void
+// Terminates the line with "\r\n" and queues it with a single debugWrite, so the
+// whole line takes one ring buffer reservation and one UDRIE1 update. With the
+// DROP_MESSAGE or MARK overflow policies a line is therefore sent whole or not at all.
+// -----------------------------------------------------------------------------------
+void debugLogCommit(debugLogLine_t *line) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_LOG);
+    line->text[line->len++] = '\r';
+    line->text[line->len++] = '\n';
+    debugWrite(line->text, line->len);
+}
+
+// -----------------------------------------------------------------------------------
+// Token record start procedure
+// -----------------------------------------------------------------------------------
+// Input : debugTokenRecord_t *rec - Record buffer to prepare
+// Input : uint32_t token - Format token (debugTokenHash of the format string)
+// Output: void
+// Writes the start byte, reserves the length byte and stores the token little-endian.
+// -----------------------------------------------------------------------------------
+void debugTokenBegin(debugTokenRecord_t *rec, uint32_t token) {
+    rec->data[0] = DEBUG_TOKEN_START;
+    rec->data[2] = (uint8_t)token;
+    rec->data[3] = (uint8_t)(token >> 8);
+    rec->data[4] = (uint8_t)(token >> 16);
+    rec->data[5] = (uint8_t)(token >> 24);
+    rec->len = 6;
+    rec->full = false;
+}
+
+// -----------------------------------------------------------------------------------
+// Token record room check procedure
+// -----------------------------------------------------------------------------------
+// Input : debugTokenRecord_t *rec - Record being assembled
+// Input : uint8_t needed - Worst-case number of bytes the next argument can produce
+// Output: uint8_t * - Where to write the argument, or NULL if it does not fit
+// A record missing an argument cannot be decoded, so the record is marked full and
+// debugTokenCommit drops it.
+// -----------------------------------------------------------------------------------
+static uint8_t *debug_token_room(debugTokenRecord_t *rec, uint8_t needed) {
+    if (rec->full || rec->len + needed > DEBUG_TOKEN_RECORD_SIZE) {
+        rec->full = true;
+        return NULL;
+    }
+    return &rec->data[rec->len];
+}
+
+// -----------------------------------------------------------------------------------
+// Token record varint append procedures
+// -----------------------------------------------------------------------------------
+// Input : debugTokenRecord_t *rec - Record being assembled
+// Input : value - Unsigned value to append
+// Output: void
+// Little-endian base-128: seven bits per byte, high bit set on all but the last byte,
+// so small values take one byte. The value is encoded on the stack first so the room
+// check uses its real length. The 32-bit version keeps AVR shifts to 32 bits.
+// -----------------------------------------------------------------------------------
+static void debug_token_bytes(debugTokenRecord_t *rec, const uint8_t *data, uint8_t len) {
+    uint8_t *out = debug_token_room(rec, len);
+    if (out) {
+        memcpy(out, data, len);
+        rec->len += len;
+    }
+}
+
+static void debug_token_varint(debugTokenRecord_t *rec, uint32_t value) {
+    uint8_t encoded[5];
+    uint8_t len = 0;
+    while (value >= 0x80) {
+        encoded[len++] = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    encoded[len++] = (uint8_t)value;
+    debug_token_bytes(rec, encoded, len);
+}
+
+static void debug_token_varint64(debugTokenRecord_t *rec, uint64_t value) {
+    uint8_t encoded[10];
+    uint8_t len = 0;
+    while (value >= 0x80) {
+        encoded[len++] = (uint8_t)value | 0x80;
+        value >>= 7;
+    }
+    encoded[len++] = (uint8_t)value;
+    debug_token_bytes(rec, encoded, len);
+}
+
+// -----------------------------------------------------------------------------------
+// Token record number append procedures
+// -----------------------------------------------------------------------------------
+// Input : debugTokenRecord_t *rec - Record being assembled
+// Input : value - Number to append
+// Output: void
+// Signed values are zig-zag encoded first (0, -1, 1, -2 ... -> 0, 1, 2, 3 ...) so small
+// negative numbers stay short. Floats are sent as their 4 IEEE-754 bytes.
+// -----------------------------------------------------------------------------------
+void debugTokenAppendInt(debugTokenRecord_t *rec, int32_t value) {
+    debug_token_varint(rec, ((uint32_t)value << 1) ^ (uint32_t)(value >> 31));
+}
+
+void debugTokenAppendUInt(debugTokenRecord_t *rec, uint32_t value) {
+    debug_token_varint(rec, value);
+}
+
+void debugTokenAppendInt64(debugTokenRecord_t *rec, int64_t value) {
+    debug_token_varint64(rec, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void debugTokenAppendUInt64(debugTokenRecord_t *rec, uint64_t value) {
+    debug_token_varint64(rec, value);
+}
+
+void debugTokenAppendFloat(debugTokenRecord_t *rec, float value) {
+    debug_token_bytes(rec, (const uint8_t *)&value, sizeof(float));
+}
+
+// -----------------------------------------------------------------------------------
+// Token record string append procedure
+// -----------------------------------------------------------------------------------
+// Input : debugTokenRecord_t *rec - Record being assembled
+// Input : const char *str - Null-terminated string, in SRAM or flash
+// Input : bool inFlash - str points to program memory (PROGMEM)
+// Output: void
+// Appends a length byte and the characters, cutting the string to the room left.
+// -----------------------------------------------------------------------------------
+void debugTokenAppendString(debugTokenRecord_t *rec, const char *str, bool inFlash) {
+    uint8_t *out = debug_token_room(rec, 1);
+    if (!out) {
+        return;
+    }
+    size_t len = inFlash ? strlen_P(str) : strlen(str);
+    uint8_t room = DEBUG_TOKEN_RECORD_SIZE - rec->len - 1;
+    if (len > room) {
+        len = room;
+    }
+    out[0] = (uint8_t)len;
+    if (inFlash) {
+        memcpy_P(&out[1], str, len);
+    } else {
+        memcpy(&out[1], str, len);
+    }
+    rec->len += 1 + (uint8_t)len;
+}
+
+// -----------------------------------------------------------------------------------
+// Token record transmission procedure
+// -----------------------------------------------------------------------------------
+// Template: uint8_t C - Channel number
+// Input : const debugTokenRecord_t *rec - Completed record, length filled in
+// Output: void
+// Queues the record, with DEBUG_TIMESTAMP preceded by its timestamp: each record is a
+// line of its own.
+// -----------------------------------------------------------------------------------
+template <uint8_t C>
+static void debug_token_write(const debugTokenRecord_t *rec) {
+#if DEBUG_TIMESTAMP
+    debug_timestamp_put<C>(rec->len);
+#endif
+    debug_write_record<C>(rec->data, rec->len);
+}
+
+// -----------------------------------------------------------------------------------
+// Token record commit procedure
+// -----------------------------------------------------------------------------------
+// Input : debugTokenRecord_t *rec - Completed record
+// Output: void
+// Fills in the payload length and queues the record with a single write; a record
+// that does not fit is dropped whole so the decoder stays in step.
+// -----------------------------------------------------------------------------------
+void debugTokenCommit(debugTokenRecord_t *rec) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_TOKEN);
+    if (rec->full) {
+        return;
+    }
+    rec->data[1] = rec->len - 2;
+#if DEBUG_FAULT_BUFFER_SIZE > 0
+    if (debugSelectedChannel == DEBUG_CHANNEL_FAULT) {
+        debug_token_write<DEBUG_CHANNEL_FAULT>(rec);
+        return;
+    }
+#endif
+#if DEBUG_TELEMETRY_BUFFER_SIZE > 0
+    if (debugSelectedChannel == DEBUG_CHANNEL_TELEMETRY) {
+        debug_token_write<DEBUG_CHANNEL_TELEMETRY>(rec);
+        return;
+    }
+#endif
+    debug_token_write<DEBUG_CHANNEL_TEXT>(rec);
+}
+
+#if DEBUG_EVENT_QUEUE_SIZE > 0
+debugEventQueue_t debugEventQueue;
+static uint16_t debugEventReported;    // debugEventQueue.dropped at the last report
+
+// -----------------------------------------------------------------------------------
+// Event line room check procedure
+// -----------------------------------------------------------------------------------
+// Input : uint8_t len - Length of the expanded line
+// Output: bool - Returns true if the line, and its timestamp, can be written whole now
+// An event stays in its queue until the text channel has room for its line, so a busy
+// transmitter delays events instead of cutting them. BLOCK writers and panic mode
+// never cut output, so they need no check.
+// -----------------------------------------------------------------------------------
+static bool debug_event_fits(uint8_t len) {
+#if DEBUG_OVERFLOW_POLICY == DEBUG_OVERFLOW_BLOCK
+    (void)len;
+    return true;
+#else
+    uint16_t need = (uint16_t)len + (DEBUG_FRAMING ? DEBUG_FRAME_OVERHEAD : 0);
+#if DEBUG_TIMESTAMP
+    if (debugChannel<DEBUG_CHANNEL_TEXT>::lineStart) {
+        need += DEBUG_TIMESTAMP_LENGTH + (DEBUG_FRAMING ? DEBUG_FRAME_OVERHEAD : 0);
+    }
+#endif
+    return debugPanicMode || debug_buffer_space(&debugChannel<DEBUG_CHANNEL_TEXT>::buffer) >= need;
+#endif
+}
+
+// -----------------------------------------------------------------------------------
+// Event queue service procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: uint8_t - Number of events printed
+// Call from the main loop. Expands queued debugEvent records, oldest first, into
+// "evt <id>: <arg>" lines on the text channel, and reports events lost to a full
+// queue as "[N events dropped]" once the queue is empty. Only events queued before the
+// call are printed, so a busy ISR cannot keep it looping. Stops early, leaving the
+// rest queued, when the text ring buffer is full. debugPanicBegin calls it too.
+// -----------------------------------------------------------------------------------
+uint8_t debugEventService(void) {
+    DEBUG_PROFILE_SCOPE(DEBUG_PROFILE_EVENTS);
+    static const char prefix[] PROGMEM = "evt ";
+    static const char suffix[] PROGMEM = " events dropped]\r\n";
+    char line[24];
+    uint8_t count = 0;
+    uint8_t tail = debugEventQueue.tail;
+    uint8_t head = debugEventQueue.head;
+    DEBUG_MEMORY_BARRIER();         // Entries read after the head that publishes them
+    while (tail != head) {
+        memcpy_P(line, prefix, sizeof(prefix) - 1);
+        uint8_t len = sizeof(prefix) - 1;
+        len += debug_format_uint32(&line[len], debugEventQueue.entry[tail].id, 1);
+        line[len++] = ':';
+        line[len++] = ' ';
+        len += debug_format_uint32(&line[len], debugEventQueue.entry[tail].arg, 1);
+        line[len++] = '\r';
+        line[len++] = '\n';
+        if (!debug_event_fits(len)) {
+            return count;
+        }
+        debug_text_channel_write<DEBUG_CHANNEL_TEXT>(line, len, false);
+        tail = (tail + 1) & (DEBUG_EVENT_QUEUE_SIZE - 1);
+        DEBUG_MEMORY_BARRIER();     // Entry read before its slot is released
+        debugEventQueue.tail = tail;
+        count++;
+    }
+
+    uint16_t dropped;
+    do {
+        dropped = debugEventQueue.dropped;      // Two bytes: re-read if an ISR changed it
+    } while (dropped != debugEventQueue.dropped);
+    uint16_t lost = dropped - debugEventReported;
+    if (lost > 0) {
+        uint8_t len = 0;
+        line[len++] = '[';
+        len += debug_format_uint32(&line[len], lost, 1);
+        memcpy_P(&line[len], suffix, sizeof(suffix) - 1);
+        len += sizeof(suffix) - 1;
+        if (debug_event_fits(len)) {
+            debug_text_channel_write<DEBUG_CHANNEL_TEXT>(line, len, false);
+            debugEventReported += lost;
+        }
+    }
+    return count;
+}
+#else
+uint8_t debugEventService(void) {
+    return 0;
+}
+#endif
+
+#if DEBUG_TIMESTAMP && !defined(DEBUG_TIMESTAMP_SOURCE)
+// -----------------------------------------------------------------------------------
+// Timer1 overflow interrupt service routine (DEBUG_TIMESTAMP)
+// -----------------------------------------------------------------------------------
+// Input : None (ISR triggered by hardware)
+// Output: None
+// Counts the upper 16 bits of the timestamp clock, once every 65536 ticks.
+// -----------------------------------------------------------------------------------
+ISR(TIMER1_OVF_vect) {
+    debugTimestampHigh++;
+}
+#endif
+
+// -----------------------------------------------------------------------------------
+// USART data register empty interrupt service routines
+// -----------------------------------------------------------------------------------
+// Input : None (ISR triggered by hardware)
+// Output: None
+// One per USART that a channel uses; each runs debug_port_service for its port.
+// DEBUG_PROFILE times the body in the DEBUG_PROFILE_ISR slot.
+// -----------------------------------------------------------------------------------
+#if DEBUG_PORT_USED(0)
+ISR(DEBUG_USART0_UDRE_vect) {
+    DEBUG_PROFILE_INTERRUPT();
+#if DEBUG_STATS
+    debugPort<0>::interrupts++;
+#endif
+    debug_port_service<0>();
+}
+#endif
+#if DEBUG_PORT_USED(1)
+ISR(DEBUG_USART1_UDRE_vect) {
+    DEBUG_PROFILE_INTERRUPT();
+#if DEBUG_STATS
+    debugPort<1>::interrupts++;
+#endif
+    debug_port_service<1>();
+}
+#endif
+#if DEBUG_PORT_USED(2)
+ISR(DEBUG_USART2_UDRE_vect) {
+    DEBUG_PROFILE_INTERRUPT();
+#if DEBUG_STATS
+    debugPort<2>::interrupts++;
+#endif
+    debug_port_service<2>();
+}
+#endif
+#if DEBUG_PORT_USED(3)
+ISR(DEBUG_USART3_UDRE_vect) {
+    DEBUG_PROFILE_INTERRUPT();
+#if DEBUG_STATS
+    debugPort<3>::interrupts++;
+#endif
+    debug_port_service<3>();
+}
+#endif
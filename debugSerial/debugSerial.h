@@ -14,9 +14,8 @@
  * 2. Include this header: #include "debugSerial.h"
  * 3. Call debugSerialBegin(baud) to initialize UART1, then use debugPrint* functions.
  *
- * For ATmega328P (which has only UART0):
- * - Modify debugSerial.cpp to use UART0 registers (e.g., UBRR0H, UBRR0L, UCSR0A, etc.).
- * - See README.md for detailed instructions.
+ * For ATmega328P (which has only UART0) the library selects USART0 automatically; on
+ * other parts define DEBUG_USART to pick the port. See README.md for details.
  *
  * Note: F_CPU must match your micro-controller's clock frequency for correct baud rates.
  */
@@ -26,28 +25,705 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <avr/pgmspace.h>
 
 #ifndef F_CPU
 #error "F_CPU must be defined (e.g., F_CPU=8000000UL or F_CPU=16000000UL) in project settings or source file."
 #endif
 
-#define DEBUG_BUFFER_SIZE 100
+// Transmit ring buffer size in bytes. Must be a power of two between 2 and 256 so the
+// head/tail indices wrap with a bit mask instead of a division. One slot is kept free
+// to tell a full buffer from an empty one, so DEBUG_BUFFER_SIZE - 1 bytes are usable.
+#ifndef DEBUG_BUFFER_SIZE
+#define DEBUG_BUFFER_SIZE 128
+#endif
+
+#if (DEBUG_BUFFER_SIZE < 2) || (DEBUG_BUFFER_SIZE > 256) || ((DEBUG_BUFFER_SIZE & (DEBUG_BUFFER_SIZE - 1)) != 0)
+#error "DEBUG_BUFFER_SIZE must be a power of two between 2 and 256."
+#endif
+
+#define DEBUG_BUFFER_MASK (DEBUG_BUFFER_SIZE - 1)
+
+// USART used for the text output (print functions, debugLog, token records). Defaults to
+// USART1 on the ATmega328PB and to USART0 on parts that have only one. Register names,
+// interrupt vector and TX pin come from the debugUsart<N> traits at compile time.
+#ifndef DEBUG_USART
+#if defined(__AVR_ATmega328P__) || defined(__AVR_ATmega328__) || defined(__AVR_ATmega168P__) || \
+    defined(__AVR_ATmega168__) || defined(__AVR_ATmega88P__) || defined(__AVR_ATmega88__) || \
+    defined(__AVR_ATmega48P__) || defined(__AVR_ATmega48__)
+#define DEBUG_USART 0
+#else
+#define DEBUG_USART 1
+#endif
+#endif
+
+// USART used for debugTelemetry* records. Give it its own port to keep the binary
+// stream apart from the text and double the bandwidth.
+#ifndef DEBUG_TELEMETRY_USART
+#define DEBUG_TELEMETRY_USART DEBUG_USART
+#endif
+
+// Channels: independent ring buffers, each with its own size and USART. The text
+// channel (DEBUG_BUFFER_SIZE bytes on DEBUG_USART) always exists; the others are
+// enabled by giving them a buffer size. Channels sharing a USART are sent in priority
+// order fault, text, telemetry, switching only between messages.
+#define DEBUG_CHANNEL_TEXT       0
+#define DEBUG_CHANNEL_TELEMETRY  1
+#define DEBUG_CHANNEL_FAULT      2
+
+// Telemetry channel buffer size. 0 queues telemetry records in the text buffer, which
+// is only possible while both use the same USART.
+#ifndef DEBUG_TELEMETRY_BUFFER_SIZE
+#if DEBUG_TELEMETRY_USART != DEBUG_USART
+#define DEBUG_TELEMETRY_BUFFER_SIZE DEBUG_BUFFER_SIZE
+#else
+#define DEBUG_TELEMETRY_BUFFER_SIZE 0
+#endif
+#endif
+
+// Fault channel buffer size (0 disables it) and USART. Text selected into it with
+// debugChannelSelect(DEBUG_CHANNEL_FAULT) has reserved space that bulk output cannot
+// fill, and goes out ahead of the other channels on its USART.
+#ifndef DEBUG_FAULT_BUFFER_SIZE
+#define DEBUG_FAULT_BUFFER_SIZE 0
+#endif
+#ifndef DEBUG_FAULT_USART
+#define DEBUG_FAULT_USART DEBUG_USART
+#endif
+
+#if (DEBUG_USART < 0) || (DEBUG_USART > 3) || (DEBUG_TELEMETRY_USART < 0) || (DEBUG_TELEMETRY_USART > 3) || \
+    (DEBUG_FAULT_USART < 0) || (DEBUG_FAULT_USART > 3)
+#error "DEBUG_USART, DEBUG_TELEMETRY_USART and DEBUG_FAULT_USART must be between 0 and 3."
+#endif
+
+#if (DEBUG_TELEMETRY_BUFFER_SIZE == 0) && (DEBUG_TELEMETRY_USART != DEBUG_USART)
+#error "A DEBUG_TELEMETRY_USART of its own needs a DEBUG_TELEMETRY_BUFFER_SIZE."
+#endif
+
+#if (DEBUG_TELEMETRY_BUFFER_SIZE != 0) && ((DEBUG_TELEMETRY_BUFFER_SIZE < 8) || (DEBUG_TELEMETRY_BUFFER_SIZE > 256) || \
+    ((DEBUG_TELEMETRY_BUFFER_SIZE & (DEBUG_TELEMETRY_BUFFER_SIZE - 1)) != 0))
+#error "DEBUG_TELEMETRY_BUFFER_SIZE must be 0 or a power of two between 8 and 256."
+#endif
+
+#if (DEBUG_FAULT_BUFFER_SIZE != 0) && ((DEBUG_FAULT_BUFFER_SIZE < 2) || (DEBUG_FAULT_BUFFER_SIZE > 256) || \
+    ((DEBUG_FAULT_BUFFER_SIZE & (DEBUG_FAULT_BUFFER_SIZE - 1)) != 0))
+#error "DEBUG_FAULT_BUFFER_SIZE must be 0 or a power of two between 2 and 256."
+#endif
+
+// Overflow policies: what happens when a write does not fit in the ring buffer.
+#define DEBUG_OVERFLOW_DROP_NEWEST   0  // Keep what fits, discard the rest (default)
+#define DEBUG_OVERFLOW_DROP_OLDEST   1  // Overwrite the oldest queued bytes
+#define DEBUG_OVERFLOW_BLOCK         2  // Spin until the transmitter frees space
+#define DEBUG_OVERFLOW_DROP_MESSAGE  3  // Queue a whole write or none of it
+#define DEBUG_OVERFLOW_MARK          4  // As DROP_MESSAGE, then queue "[N bytes dropped]"
+
+#ifndef DEBUG_OVERFLOW_POLICY
+#define DEBUG_OVERFLOW_POLICY DEBUG_OVERFLOW_DROP_NEWEST
+#endif
+
+// Framed output. With DEBUG_FRAMING set to 1, every write (one string, number, debugLog
+// line or token record) is sent as COBS(sequence, data, CRC-16) followed by a 0x00
+// delimiter, so the host can detect dropped and corrupted messages. The sequence byte
+// holds the channel number in its top two bits and a per-channel counter below. The
+// CRC is CRC-16/MCRF4XX (avr-libc _crc_ccitt_update, initial value 0xFFFF) over the
+// sequence byte and data. host/tools/debugDeframe unpacks the stream and reports the loss.
+#ifndef DEBUG_FRAMING
+#define DEBUG_FRAMING 0
+#endif
+
+// Bytes a frame adds to its data: COBS code, sequence number, CRC-16, delimiter
+#define DEBUG_FRAME_OVERHEAD 5
+
+// Sequence byte layout: channel << DEBUG_FRAME_SEQ_BITS | counter
+#define DEBUG_FRAME_SEQ_BITS 6
+#define DEBUG_FRAME_SEQ_MASK ((1 << DEBUG_FRAME_SEQ_BITS) - 1)
+
+// Largest data block per frame on the text channel (other channels use their own buffer
+// size); longer writes are split. Keeps a whole frame within the usable ring buffer space
+// and below 254 bytes, so it needs only one COBS code byte besides the ones that replace
+// zero bytes.
+#define DEBUG_FRAME_DATA_MAX (DEBUG_BUFFER_SIZE - 1 - DEBUG_FRAME_OVERHEAD)
+
+#if DEBUG_FRAMING && ((DEBUG_BUFFER_SIZE < 8) || ((DEBUG_FAULT_BUFFER_SIZE != 0) && (DEBUG_FAULT_BUFFER_SIZE < 8)) || \
+    ((DEBUG_TELEMETRY_BUFFER_SIZE != 0) && (DEBUG_TELEMETRY_BUFFER_SIZE < 16)))
+#error "DEBUG_FRAMING needs channel buffers of at least 8 bytes (16 for telemetry)."
+#endif
+
+// Largest baud rate error debugSerialBegin<baud>() accepts, in 0.1 % steps (default
+// 2.0 %, as avr-libc's <util/setbaud.h>). Both ends of the link add their error.
+#ifndef DEBUG_BAUD_MAX_ERROR
+#define DEBUG_BAUD_MAX_ERROR 20
+#endif
+
+// Polling step of debugFlushTimeout in CPU cycles (a multiple of 4, at most 1024)
+#ifndef DEBUG_FLUSH_POLL_CYCLES
+#define DEBUG_FLUSH_POLL_CYCLES 64
+#endif
+
+#if (DEBUG_FLUSH_POLL_CYCLES < 4) || (DEBUG_FLUSH_POLL_CYCLES > 1024) || ((DEBUG_FLUSH_POLL_CYCLES % 4) != 0)
+#error "DEBUG_FLUSH_POLL_CYCLES must be a multiple of 4 between 4 and 1024."
+#endif
+
+// 1: the output functions may also be called from interrupt handlers. Each ring buffer
+// update runs with interrupts masked and restores SREG afterwards, so it never enables
+// interrupts the caller had disabled (inside an ISR or ATOMIC_BLOCK). 0: lock-free, for
+// firmware that prints from the main loop only.
+#ifndef DEBUG_ISR_SAFE
+#define DEBUG_ISR_SAFE 1
+#endif
+
+// 1: count queued and dropped bytes, ring buffer high-water mark, BLOCK waits and UDRE
+// interrupts per channel, read with debugStatsGet. 0 compiles the counters out.
+#ifndef DEBUG_STATS
+#define DEBUG_STATS 0
+#endif
+
+// 1: instrumentation build. debugSerialBegin starts Timer1 free-running at the CPU clock
+// and the public functions and UDRE interrupts time themselves with TCNT1, keeping
+// calls and min/max/total cycles per profile slot for debugProfileDump. The library
+// then owns Timer1. 0 compiles the instrumentation out.
+#ifndef DEBUG_PROFILE
+#define DEBUG_PROFILE 0
+#endif
+
+// Line timestamps: every line of text output starts with the time its first byte was
+// queued, DEBUG_TIMESTAMP_DECIMAL as "[ticks] " or DEBUG_TIMESTAMP_BINARY as a 5-byte
+// DEBUG_TIMESTAMP_START record. 0 (no stamps) is the default.
+#define DEBUG_TIMESTAMP_DECIMAL 1
+#define DEBUG_TIMESTAMP_BINARY  2
+#ifndef DEBUG_TIMESTAMP
+#define DEBUG_TIMESTAMP 0
+#endif
+
+// Timer1 prescaler for the timestamp clock (1, 8, 64, 256 or 1024): a tick is
+// DEBUG_TIMESTAMP_PRESCALER / F_CPU seconds, 4 us by default at 16 MHz, and the 32-bit
+// count wraps after 2^32 ticks (4.8 hours). DEBUG_PROFILE also runs Timer1 and needs 1.
+#ifndef DEBUG_TIMESTAMP_PRESCALER
+#if DEBUG_PROFILE
+#define DEBUG_TIMESTAMP_PRESCALER 1
+#else
+#define DEBUG_TIMESTAMP_PRESCALER 64
+#endif
+#endif
+
+// Define DEBUG_TIMESTAMP_SOURCE as the name of a function "uint32_t name(void)" with C
+// linkage, e.g. micros on Arduino, to take the stamps from it instead of Timer1.
+
+#if (DEBUG_TIMESTAMP < 0) || (DEBUG_TIMESTAMP > DEBUG_TIMESTAMP_BINARY)
+#error "DEBUG_TIMESTAMP must be 0, DEBUG_TIMESTAMP_DECIMAL or DEBUG_TIMESTAMP_BINARY."
+#endif
+
+#if (DEBUG_TIMESTAMP_PRESCALER != 1) && (DEBUG_TIMESTAMP_PRESCALER != 8) && (DEBUG_TIMESTAMP_PRESCALER != 64) && \
+    (DEBUG_TIMESTAMP_PRESCALER != 256) && (DEBUG_TIMESTAMP_PRESCALER != 1024)
+#error "DEBUG_TIMESTAMP_PRESCALER must be 1, 8, 64, 256 or 1024."
+#endif
+
+#if DEBUG_PROFILE && DEBUG_TIMESTAMP && !defined(DEBUG_TIMESTAMP_SOURCE) && (DEBUG_TIMESTAMP_PRESCALER != 1)
+#error "DEBUG_PROFILE counts CPU cycles on Timer1: Timer1 timestamps need DEBUG_TIMESTAMP_PRESCALER 1."
+#endif
+
+// Profile slots (DEBUG_PROFILE): one per public function family. A slot times the
+// outermost library call only, so debugPrintIntln counts once, not also as the
+// debugPrintInt inside it.
+#define DEBUG_PROFILE_ISR        0      // USARTn UDRE interrupt
+#define DEBUG_PROFILE_CHAR       1      // uart1_print_char
+#define DEBUG_PROFILE_WRITE      2      // debugWrite, debugWrite_P
+#define DEBUG_PROFILE_PRINT      3      // debugPrint(ln), debugPrint(ln)_P
+#define DEBUG_PROFILE_INT        4      // debugPrint(U)Int(ln), debugPrint(U)IntPadded
+#define DEBUG_PROFILE_INT64      5      // The 64-bit variants of the above
+#define DEBUG_PROFILE_FLOAT      6      // debugPrintFloat(ln)
+#define DEBUG_PROFILE_FIXED      7      // debugPrintFixed(ln), debugPrintQ7/Q15/Q16
+#define DEBUG_PROFILE_HEX        8      // debugPrintHex8/16/32, debugPrintBin
+#define DEBUG_PROFILE_HEX_DUMP   9      // debugHexDump
+#define DEBUG_PROFILE_LOG        10     // debugLogCommit
+#define DEBUG_PROFILE_TOKEN      11     // debugTokenCommit
+#define DEBUG_PROFILE_TELEMETRY  12     // debugTelemetryBegin, debugTelemetrySample
+#define DEBUG_PROFILE_EVENTS     13     // debugEventService
+#define DEBUG_PROFILE_SLOTS      14
+
+// Capacity of the ISR event queue (debugEvent) in entries: a power of two between 2 and
+// 256, or 0 to leave the queue out. Each entry costs 3 bytes of SRAM.
+#ifndef DEBUG_EVENT_QUEUE_SIZE
+#define DEBUG_EVENT_QUEUE_SIZE 0
+#endif
+
+#if (DEBUG_EVENT_QUEUE_SIZE != 0) && ((DEBUG_EVENT_QUEUE_SIZE < 2) || (DEBUG_EVENT_QUEUE_SIZE > 256) || \
+    ((DEBUG_EVENT_QUEUE_SIZE & (DEBUG_EVENT_QUEUE_SIZE - 1)) != 0))
+#error "DEBUG_EVENT_QUEUE_SIZE must be 0 or a power of two between 2 and 256."
+#endif
+
+// Widest field accepted by the *Padded print functions (20 digits + sign)
+#define DEBUG_NUMBER_MAX_WIDTH 21
+
+// Most decimal places debugPrintFloat will print (float carries ~7 significant digits)
+#define DEBUG_FLOAT_MAX_DECIMALS 9
+
+// Longest decimal with a fraction: sign + 20 digits + decimal point
+#define DEBUG_DECIMAL_MAX_WIDTH 22
+
+// Size of the stack buffer debugLog assembles one line in, including "\r\n".
+// Longer lines are cut at the last item that fits.
+#ifndef DEBUG_LOG_LINE_SIZE
+#define DEBUG_LOG_LINE_SIZE 64
+#endif
+
+#if (DEBUG_LOG_LINE_SIZE < DEBUG_DECIMAL_MAX_WIDTH + 2) || (DEBUG_LOG_LINE_SIZE > 255)
+#error "DEBUG_LOG_LINE_SIZE must be between 24 and 255."
+#endif
+
+// Default decimal places for float arguments to debugLog
+#ifndef DEBUG_LOG_FLOAT_DECIMALS
+#define DEBUG_LOG_FLOAT_DECIMALS 2
+#endif
+
+// Length of one debugHexDump line: "XXXX:" + 16 * " XX" + "  |" + 16 chars + "|\r\n"
+#define DEBUG_HEXDUMP_LINE_LENGTH 75
+
+// Keeps a string literal in flash instead of SRAM, for the *_P print functions:
+//   debugPrintln_P(DEBUG_STR("Sensor ready"));
+#define DEBUG_STR(s) PSTR(s)
+
+// Tokenized logging. A record is DEBUG_TOKEN_START, the payload length, then the
+// payload: the 32-bit format token (little-endian) followed by the arguments, encoded
+// as zig-zag varints (signed), varints (unsigned), 4-byte floats and length-prefixed
+// strings. Format strings are kept out of the firmware image in DEBUG_TOKEN_SECTION,
+// and host/tools/debugDecode turns records back into text.
+#define DEBUG_TOKEN_START 0x1E
+#define DEBUG_TOKEN_SECTION ".debugSerial.tokens"
+
+// Size of the stack buffer one record is assembled in (start byte, length and token
+// included). Records whose arguments do not fit are dropped whole.
+#ifndef DEBUG_TOKEN_RECORD_SIZE
+#define DEBUG_TOKEN_RECORD_SIZE 32
+#endif
+
+#if (DEBUG_TOKEN_RECORD_SIZE < 6) || (DEBUG_TOKEN_RECORD_SIZE > 255)
+#error "DEBUG_TOKEN_RECORD_SIZE must be between 6 and 255."
+#endif
+
+// Binary telemetry. A sample record is DEBUG_TELEMETRY_START, a channel byte, then
+// either the value as 4 bytes little-endian, or, when the channel byte has
+// DEBUG_TELEMETRY_DELTA set, the zig-zag varint difference to the channel's previous
+// sample. Channel DEBUG_TELEMETRY_BEGIN marks debugTelemetryBegin and is followed by
+// the channel count. host/tools/debugTelemetry converts the records to CSV.
+#define DEBUG_TELEMETRY_START 0x1D
+#define DEBUG_TELEMETRY_DELTA 0x80
+#define DEBUG_TELEMETRY_BEGIN 0x7F
+
+// Binary line timestamp (DEBUG_TIMESTAMP_BINARY): DEBUG_TIMESTAMP_START, then the
+// 32-bit tick count little-endian. host/tools/debugDecode prints it as "[ticks] ".
+#define DEBUG_TIMESTAMP_START 0x1C
+
+// Number of channels debugTelemetrySample accepts (one int32_t of SRAM each for delta
+// encoding)
+#ifndef DEBUG_TELEMETRY_CHANNELS
+#define DEBUG_TELEMETRY_CHANNELS 8
+#endif
+
+#if (DEBUG_TELEMETRY_CHANNELS < 1) || (DEBUG_TELEMETRY_CHANNELS > 127)
+#error "DEBUG_TELEMETRY_CHANNELS must be between 1 and 127."
+#endif
+
+// Set to 0 to send every sample as a fixed 4-byte value instead of a delta
+#ifndef DEBUG_TELEMETRY_USE_DELTA
+#define DEBUG_TELEMETRY_USE_DELTA 1
+#endif
 
-// Ring buffer structure for UART1 transmission
+// With delta encoding, every Nth sample of a channel is sent in full so a host that
+// starts listening mid-stream can pick up (0: only the first sample after
+// debugTelemetryBegin and after a dropped record)
+#ifndef DEBUG_TELEMETRY_KEYFRAME
+#define DEBUG_TELEMETRY_KEYFRAME 32
+#endif
+
+#if (DEBUG_TELEMETRY_KEYFRAME < 0) || (DEBUG_TELEMETRY_KEYFRAME > 255)
+#error "DEBUG_TELEMETRY_KEYFRAME must be between 0 and 255."
+#endif
+
+// Line assembly buffer for debugLog / debugLogAppend*
 typedef struct {
-    char debugBuffer[DEBUG_BUFFER_SIZE];
-    volatile uint8_t debugHead;
-    volatile uint8_t debugTail;
-} debugRingBuffer_t;
+    char text[DEBUG_LOG_LINE_SIZE];
+    uint8_t len;
+    bool full;      // An item did not fit; everything after it is skipped
+} debugLogLine_t;
+
+// Record assembly buffer for DEBUG_TOKEN_LOG / debugTokenAppend*
+typedef struct {
+    uint8_t data[DEBUG_TOKEN_RECORD_SIZE];
+    uint8_t len;
+    bool full;      // An argument did not fit; the record will not be sent
+} debugTokenRecord_t;
+
+// Per-channel transmit statistics (DEBUG_STATS), in ring buffer bytes: with
+// DEBUG_FRAMING they include the frame overhead, and a frame dropped whole counts as
+// its data length + DEBUG_FRAME_OVERHEAD.
+typedef struct {
+    uint32_t enqueued;      // Bytes queued (panic mode output included)
+    uint32_t dropped;       // Bytes lost to the overflow policy
+    uint32_t blockedWaits;  // DEBUG_OVERFLOW_BLOCK: writes that had to wait for space
+    uint32_t blockedBytes;  // Bytes those writes waited for; x 10 bit times = time blocked
+    uint32_t interrupts;    // UDRE interrupts serviced on the channel's USART
+    uint8_t highWater;      // Most bytes ever waiting in the ring buffer
+} debugStats_t;
+
+// Timing of one profile slot (DEBUG_PROFILE), in CPU cycles with the cost of the
+// timestamps themselves subtracted. min is the undisturbed cost; max and total also
+// include interrupts taken during the call.
+typedef struct {
+    uint32_t calls;
+    uint32_t total;         // Wraps at 2^32 cycles
+    uint16_t min;           // 0xFFFF until the first call
+    uint16_t max;
+} debugProfile_t;
 
 // Function prototypes
 void debugSerialBegin(int32_t baud);
+void debugSerialBeginUbrr(uint16_t ubrr, bool doubleSpeed);
+uint8_t debugChannelSelect(uint8_t channel);
+uint16_t debugPending(void);
+void debugFlush(void);
+bool debugFlushTimeout(uint32_t cycles);
+void debugPanicBegin(void);
+bool debugStatsGet(uint8_t channel, debugStats_t *stats);
+void debugStatsReset(void);
+bool debugProfileGet(uint8_t slot, debugProfile_t *profile);
+void debugProfileReset(void);
+void debugProfileDump(void);
+uint32_t debugTimestamp(void);
 void uart1_print_char(char data);
+void debugWrite(const char *data, uint8_t len);
 void debugPrint(const char *str);
 void debugPrintln(const char *str);
+void debugWrite_P(const char *data, uint8_t len);
+void debugPrint_P(const char *str);
+void debugPrintln_P(const char *str);
 void debugPrintInt(int32_t value);
 void debugPrintIntln(int32_t value);
+void debugPrintUInt(uint32_t value);
+void debugPrintUIntln(uint32_t value);
+void debugPrintInt64(int64_t value);
+void debugPrintInt64ln(int64_t value);
+void debugPrintUInt64(uint64_t value);
+void debugPrintUInt64ln(uint64_t value);
+void debugPrintIntPadded(int32_t value, uint8_t width, char fill);
+void debugPrintUIntPadded(uint32_t value, uint8_t width, char fill);
+void debugPrintInt64Padded(int64_t value, uint8_t width, char fill);
+void debugPrintUInt64Padded(uint64_t value, uint8_t width, char fill);
 void debugPrintFloat(float value, uint8_t decimalPlaces);
 void debugPrintFloatln(float value, uint8_t decimalPlaces);
+void debugPrintFixed(int32_t raw, uint8_t fracBits, uint8_t decimals);
+void debugPrintFixedln(int32_t raw, uint8_t fracBits, uint8_t decimals);
+void debugPrintQ7(int8_t raw, uint8_t decimals);
+void debugPrintQ15(int16_t raw, uint8_t decimals);
+void debugPrintQ16(int32_t raw, uint8_t decimals);
+void debugPrintHex8(uint8_t value);
+void debugPrintHex16(uint16_t value);
+void debugPrintHex32(uint32_t value);
+void debugPrintBin(uint32_t value, uint8_t bits);
+void debugHexDump(const void *data, uint16_t len);
+
+// Binary telemetry: announce the channel count, then sample channels in ascending order
+void debugTelemetryBegin(uint8_t channels);
+void debugTelemetrySample(uint8_t channel, int32_t value);
+
+// Line builder: start a debugLogLine_t, append items, then commit it as one write
+void debugLogBegin(debugLogLine_t *line);
+void debugLogAppendString(debugLogLine_t *line, const char *str, bool inFlash);
+void debugLogAppendChar(debugLogLine_t *line, char c);
+void debugLogAppendInt(debugLogLine_t *line, int32_t value);
+void debugLogAppendUInt(debugLogLine_t *line, uint32_t value);
+void debugLogAppendInt64(debugLogLine_t *line, int64_t value);
+void debugLogAppendUInt64(debugLogLine_t *line, uint64_t value);
+void debugLogAppendFloat(debugLogLine_t *line, float value, uint8_t decimals);
+void debugLogAppendHex(debugLogLine_t *line, uint32_t value, uint8_t digits);
+void debugLogCommit(debugLogLine_t *line);
+
+// Record builder for tokenized logging: start with the format token, append the
+// arguments in format order, then commit the record as one write
+void debugTokenBegin(debugTokenRecord_t *rec, uint32_t token);
+void debugTokenAppendInt(debugTokenRecord_t *rec, int32_t value);
+void debugTokenAppendUInt(debugTokenRecord_t *rec, uint32_t value);
+void debugTokenAppendInt64(debugTokenRecord_t *rec, int64_t value);
+void debugTokenAppendUInt64(debugTokenRecord_t *rec, uint64_t value);
+void debugTokenAppendFloat(debugTokenRecord_t *rec, float value);
+void debugTokenAppendString(debugTokenRecord_t *rec, const char *str, bool inFlash);
+void debugTokenCommit(debugTokenRecord_t *rec);
+uint8_t debugEventService(void);
+
+#if DEBUG_EVENT_QUEUE_SIZE > 0
+// ISR event queue. debugEvent fills it from interrupt context (AVR interrupts do not
+// nest, so there is one producer at a time) and debugEventService empties it from the
+// main loop, each side writing only its own index.
+typedef struct {
+    uint8_t id;
+    uint16_t arg;
+} debugEvent_t;
+
+typedef struct {
+    debugEvent_t entry[DEBUG_EVENT_QUEUE_SIZE];
+    volatile uint8_t head;      // Next free entry, written by debugEvent
+    volatile uint8_t tail;      // Oldest entry, written by debugEventService
+    volatile uint16_t dropped;  // Events lost to a full queue, counting modulo 65536
+} debugEventQueue_t;
+
+extern debugEventQueue_t debugEventQueue;
+
+// -----------------------------------------------------------------------------------
+// ISR event procedure
+// -----------------------------------------------------------------------------------
+// Input : uint8_t id - Event number, printed as is
+// Input : uint16_t arg - Event argument
+// Output: void
+// Stores the event in the queue for debugEventService to print later, with no
+// formatting and no ring buffer access: inline, it is two index loads, a compare,
+// three stores and an index store, where a debugPrint line formats and copies text.
+// The cycle count depends on the compiler; read TCNT1 around it on the part to get it.
+// Call it with interrupts disabled, i.e. from an interrupt handler (wrap main loop
+// calls in ATOMIC_BLOCK). A full queue drops the event and counts it.
+// -----------------------------------------------------------------------------------
+static inline void debugEvent(uint8_t id, uint16_t arg) {
+    uint8_t head = debugEventQueue.head;
+    uint8_t next = (uint8_t)((head + 1) & (DEBUG_EVENT_QUEUE_SIZE - 1));
+    if (next == debugEventQueue.tail) {
+        debugEventQueue.dropped++;
+        return;
+    }
+    debugEventQueue.entry[head].id = id;
+    debugEventQueue.entry[head].arg = arg;
+    __asm__ __volatile__("" ::: "memory");      // Entry stored before it is published
+    debugEventQueue.head = next;
+}
+#else
+static inline void debugEvent(uint8_t id, uint16_t arg) {
+    (void)id;
+    (void)arg;
+}
+#endif
+
+#if defined(__cplusplus) && (__cplusplus >= 201103L)
+// -----------------------------------------------------------------------------------
+// Type-safe line logging (C++11)
+// -----------------------------------------------------------------------------------
+// debugLog("temp=", t, " rpm=", rpm, DEBUG_F(" ok"));
+// Each argument picks its formatter by overload resolution at compile time. The line
+// is assembled in a DEBUG_LOG_LINE_SIZE stack buffer, terminated with "\r\n" and
+// committed with one ring buffer reservation. Supported arguments: strings (SRAM, or
+// flash via DEBUG_F), char, bool, all integer types, float/double (with
+// DEBUG_LOG_FLOAT_DECIMALS places, or debugLogFloat(value, decimals)) and
+// debugLogHex(value, digits).
+// -----------------------------------------------------------------------------------
+
+// Marker type for flash strings, so debugLog can tell them from SRAM pointers
+class debugFlashString;
+#define DEBUG_F(s) (reinterpret_cast<const debugFlashString *>(PSTR(s)))
+
+struct debugLogFloat_t {
+    float value;
+    uint8_t decimals;
+};
+
+struct debugLogHex_t {
+    uint32_t value;
+    uint8_t digits;
+};
+
+inline debugLogFloat_t debugLogFloat(float value, uint8_t decimals) {
+    debugLogFloat_t arg = { value, decimals };
+    return arg;
+}
+
+inline debugLogHex_t debugLogHex(uint32_t value, uint8_t digits) {
+    debugLogHex_t arg = { value, digits };
+    return arg;
+}
+
+inline void debugLogAppend(debugLogLine_t &line, const char *str) { debugLogAppendString(&line, str, false); }
+inline void debugLogAppend(debugLogLine_t &line, const debugFlashString *str) {
+    debugLogAppendString(&line, reinterpret_cast<const char *>(str), true);
+}
+inline void debugLogAppend(debugLogLine_t &line, char c) { debugLogAppendChar(&line, c); }
+inline void debugLogAppend(debugLogLine_t &line, bool b) { debugLogAppendChar(&line, b ? '1' : '0'); }
+inline void debugLogAppend(debugLogLine_t &line, float v) { debugLogAppendFloat(&line, v, DEBUG_LOG_FLOAT_DECIMALS); }
+inline void debugLogAppend(debugLogLine_t &line, double v) { debugLogAppendFloat(&line, (float)v, DEBUG_LOG_FLOAT_DECIMALS); }
+inline void debugLogAppend(debugLogLine_t &line, debugLogFloat_t v) { debugLogAppendFloat(&line, v.value, v.decimals); }
+inline void debugLogAppend(debugLogLine_t &line, debugLogHex_t v) { debugLogAppendHex(&line, v.value, v.digits); }
+
+// Integer types map onto the 32-bit or 64-bit engine by size, resolved at compile time
+template <typename T>
+inline void debugLogAppendSigned(debugLogLine_t &line, T v) {
+    if (sizeof(T) <= 4) {
+        debugLogAppendInt(&line, (int32_t)v);
+    } else {
+        debugLogAppendInt64(&line, (int64_t)v);
+    }
+}
+
+template <typename T>
+inline void debugLogAppendUnsigned(debugLogLine_t &line, T v) {
+    if (sizeof(T) <= 4) {
+        debugLogAppendUInt(&line, (uint32_t)v);
+    } else {
+        debugLogAppendUInt64(&line, (uint64_t)v);
+    }
+}
+
+inline void debugLogAppend(debugLogLine_t &line, signed char v) { debugLogAppendSigned(line, v); }
+inline void debugLogAppend(debugLogLine_t &line, short v) { debugLogAppendSigned(line, v); }
+inline void debugLogAppend(debugLogLine_t &line, int v) { debugLogAppendSigned(line, v); }
+inline void debugLogAppend(debugLogLine_t &line, long v) { debugLogAppendSigned(line, v); }
+inline void debugLogAppend(debugLogLine_t &line, long long v) { debugLogAppendSigned(line, v); }
+inline void debugLogAppend(debugLogLine_t &line, unsigned char v) { debugLogAppendUnsigned(line, v); }
+inline void debugLogAppend(debugLogLine_t &line, unsigned short v) { debugLogAppendUnsigned(line, v); }
+inline void debugLogAppend(debugLogLine_t &line, unsigned int v) { debugLogAppendUnsigned(line, v); }
+inline void debugLogAppend(debugLogLine_t &line, unsigned long v) { debugLogAppendUnsigned(line, v); }
+inline void debugLogAppend(debugLogLine_t &line, unsigned long long v) { debugLogAppendUnsigned(line, v); }
+
+inline void debugLogAppendAll(debugLogLine_t &) {
+}
+
+template <typename T, typename... Rest>
+inline void debugLogAppendAll(debugLogLine_t &line, const T &first, const Rest &... rest) {
+    debugLogAppend(line, first);
+    debugLogAppendAll(line, rest...);
+}
+
+template <typename... Args>
+inline void debugLog(const Args &... args) {
+    debugLogLine_t line;
+    debugLogBegin(&line);
+    debugLogAppendAll(line, args...);
+    debugLogCommit(&line);
+}
+
+// -----------------------------------------------------------------------------------
+// Tokenized logging (C++11)
+// -----------------------------------------------------------------------------------
+// DEBUG_TOKEN_LOG("temp=%d rpm=%u", t, rpm);
+// The format string is never formatted or stored on the target. It is placed in the
+// non-loaded DEBUG_TOKEN_SECTION of the ELF file, and the call site sends only its
+// 32-bit FNV-1a hash plus the raw arguments. host/tools/debugDecode reads the section,
+// hashes each string the same way and prints every record as one line of text.
+// fmt must be a single string literal. The argument types must match the conversions:
+// %d/%i for signed integers, %u/%x/%X/%o/%c for unsigned integers and char, %f/%e/%g
+// for float/double (sent as 4-byte float) and %s for strings (SRAM, or DEBUG_F).
+// -----------------------------------------------------------------------------------
+
+// FNV-1a hash of a format string, evaluated at compile time
+constexpr uint32_t debugTokenHash(const char *s, uint32_t h = 2166136261UL) {
+    return *s ? debugTokenHash(s + 1, (uint32_t)((h ^ (uint8_t)*s) * 16777619UL)) : h;
+}
+
+#define DEBUG_TOKEN_LOG(fmt, ...) do { \
+    __asm__ __volatile__(".pushsection " DEBUG_TOKEN_SECTION ",\"\",@progbits\n\t" \
+                         ".asciz " #fmt "\n\t.popsection"); \
+    constexpr uint32_t debugToken = debugTokenHash(fmt); \
+    debugTokenLog(debugToken, ##__VA_ARGS__); \
+} while (0)
+
+inline void debugTokenAppend(debugTokenRecord_t &rec, const char *str) { debugTokenAppendString(&rec, str, false); }
+inline void debugTokenAppend(debugTokenRecord_t &rec, const debugFlashString *str) {
+    debugTokenAppendString(&rec, reinterpret_cast<const char *>(str), true);
+}
+inline void debugTokenAppend(debugTokenRecord_t &rec, char c) { debugTokenAppendUInt(&rec, (uint8_t)c); }
+inline void debugTokenAppend(debugTokenRecord_t &rec, bool b) { debugTokenAppendUInt(&rec, b ? 1 : 0); }
+inline void debugTokenAppend(debugTokenRecord_t &rec, float v) { debugTokenAppendFloat(&rec, v); }
+inline void debugTokenAppend(debugTokenRecord_t &rec, double v) { debugTokenAppendFloat(&rec, (float)v); }
+
+template <typename T>
+inline void debugTokenAppendSigned(debugTokenRecord_t &rec, T v) {
+    if (sizeof(T) <= 4) {
+        debugTokenAppendInt(&rec, (int32_t)v);
+    } else {
+        debugTokenAppendInt64(&rec, (int64_t)v);
+    }
+}
+
+template <typename T>
+inline void debugTokenAppendUnsigned(debugTokenRecord_t &rec, T v) {
+    if (sizeof(T) <= 4) {
+        debugTokenAppendUInt(&rec, (uint32_t)v);
+    } else {
+        debugTokenAppendUInt64(&rec, (uint64_t)v);
+    }
+}
+
+inline void debugTokenAppend(debugTokenRecord_t &rec, signed char v) { debugTokenAppendSigned(rec, v); }
+inline void debugTokenAppend(debugTokenRecord_t &rec, short v) { debugTokenAppendSigned(rec, v); }
+inline void debugTokenAppend(debugTokenRecord_t &rec, int v) { debugTokenAppendSigned(rec, v); }
+inline void debugTokenAppend(debugTokenRecord_t &rec, long v) { debugTokenAppendSigned(rec, v); }
+inline void debugTokenAppend(debugTokenRecord_t &rec, long long v) { debugTokenAppendSigned(rec, v); }
+inline void debugTokenAppend(debugTokenRecord_t &rec, unsigned char v) { debugTokenAppendUnsigned(rec, v); }
+inline void debugTokenAppend(debugTokenRecord_t &rec, unsigned short v) { debugTokenAppendUnsigned(rec, v); }
+inline void debugTokenAppend(debugTokenRecord_t &rec, unsigned int v) { debugTokenAppendUnsigned(rec, v); }
+inline void debugTokenAppend(debugTokenRecord_t &rec, unsigned long v) { debugTokenAppendUnsigned(rec, v); }
+inline void debugTokenAppend(debugTokenRecord_t &rec, unsigned long long v) { debugTokenAppendUnsigned(rec, v); }
+
+inline void debugTokenAppendAll(debugTokenRecord_t &) {
+}
+
+template <typename T, typename... Rest>
+inline void debugTokenAppendAll(debugTokenRecord_t &rec, const T &first, const Rest &... rest) {
+    debugTokenAppend(rec, first);
+    debugTokenAppendAll(rec, rest...);
+}
+
+template <typename... Args>
+inline void debugTokenLog(uint32_t token, const Args &... args) {
+    debugTokenRecord_t rec;
+    debugTokenBegin(&rec, token);
+    debugTokenAppendAll(rec, args...);
+    debugTokenCommit(&rec);
+}
+
+// -----------------------------------------------------------------------------------
+// Compile-time baud rate setup (C++11)
+// -----------------------------------------------------------------------------------
+// debugSerialBegin<115200>();
+// Works out UBRR for normal (16x) and double-speed (8x, U2X) mode at compile time with
+// rounding to the nearest divisor, picks U2X only when it gives a smaller error, and
+// fails to compile if the remaining error exceeds DEBUG_BAUD_MAX_ERROR or the divisor
+// does not fit the 12-bit UBRR. No division is left for startup. debugBaud<baud>
+// exposes the result, e.g. debugBaud<250000>::errorPermille.
+// -----------------------------------------------------------------------------------
+
+// UBRR + 1 for the given clocks per bit (16, or 8 with U2X), rounded to nearest
+constexpr uint64_t debugBaudDivisor(uint32_t baud, uint8_t clocks) {
+    return (F_CPU + (uint64_t)clocks * baud / 2) / ((uint64_t)clocks * baud);
+}
+
+constexpr uint64_t debugBaudDiff(uint64_t a, uint64_t b) {
+    return (a > b) ? a - b : b - a;
+}
+
+// Divides rounding up, so an error is never reported smaller than it is
+constexpr uint64_t debugBaudDivCeil(uint64_t a, uint64_t b) {
+    return (a + b - 1) / b;
+}
+
+// |F_CPU / (clocks * divisor) - baud| / baud in 0.1 % steps; all ones if the divisor
+// does not fit the 12-bit UBRR
+constexpr uint32_t debugBaudError(uint32_t baud, uint8_t clocks) {
+    return (debugBaudDivisor(baud, clocks) < 1 || debugBaudDivisor(baud, clocks) > 4096)
+        ? 0xFFFFFFFFUL
+        : (uint32_t)debugBaudDivCeil(
+              debugBaudDiff((uint64_t)F_CPU * 1000, (uint64_t)clocks * debugBaudDivisor(baud, clocks) * baud * 1000),
+              (uint64_t)clocks * debugBaudDivisor(baud, clocks) * baud);
+}
+
+template <uint32_t Baud>
+struct debugBaud {
+    static constexpr bool doubleSpeed = debugBaudError(Baud, 8) < debugBaudError(Baud, 16);
+    static constexpr uint16_t ubrr = (uint16_t)(debugBaudDivisor(Baud, doubleSpeed ? 8 : 16) - 1);
+    static constexpr uint32_t errorPermille = debugBaudError(Baud, doubleSpeed ? 8 : 16);
+};
+
+template <uint32_t Baud>
+inline void debugSerialBegin(void) {
+    static_assert(debugBaud<Baud>::errorPermille != 0xFFFFFFFFUL, "Baud rate out of UBRR range at this F_CPU.");
+    static_assert(debugBaud<Baud>::errorPermille <= DEBUG_BAUD_MAX_ERROR,
+                  "Baud rate error exceeds DEBUG_BAUD_MAX_ERROR at this F_CPU; pick another baud rate.");
+    debugSerialBeginUbrr(debugBaud<Baud>::ubrr, debugBaud<Baud>::doubleSpeed);
+}
+#endif
 
 #endif /* DEBUGSERIAL_H_ */
\ No newline at end of file
@@ -0,0 +1,121 @@
+/*
+ * debugUsart.h
+ *
+ * Compile-time USART port traits for the debugSerial library (C++, included by
+ * debugSerial.cpp only).
+ *
+ * debugUsart<N> names the registers, bit positions and TX pin of USART N, so the
+ * transmitter code in debugSerial.cpp is written once and instantiated per port.
+ * Every accessor is an inline function returning the register itself, so each access
+ * compiles to the same single I/O instruction as writing UCSR1B by hand: there is no
+ * runtime port number or pointer.
+ *
+ * Supported parts:
+ * - ATmega328PB: USART0 (TX on PD1), USART1 (TX on PD3)
+ * - ATmega328P:  USART0 (TX on PD1)
+ * - ATmega2560:  USART0 (PE1), USART1 (PD3), USART2 (PH1), USART3 (PJ1)
+ * Other parts get the traits of every USARTn whose registers <avr/io.h> defines, but
+ * no TX pin setup.
+ */
+
+#ifndef DEBUGUSART_H_
+#define DEBUGUSART_H_
+
+#include <avr/io.h>
+
+// UDRE interrupt vector per USART. The single-USART parts call it USART_UDRE_vect.
+#if defined(USART0_UDRE_vect)
+#define DEBUG_USART0_UDRE_vect USART0_UDRE_vect
+#else
+#define DEBUG_USART0_UDRE_vect USART_UDRE_vect
+#endif
+#define DEBUG_USART1_UDRE_vect USART1_UDRE_vect
+#define DEBUG_USART2_UDRE_vect USART2_UDRE_vect
+#define DEBUG_USART3_UDRE_vect USART3_UDRE_vect
+
+// TX pin per USART: DDR register, PORT register, bit
+#if defined(__AVR_ATmega328PB__)
+#define DEBUG_USART0_TX DDRD, PORTD, 1
+#define DEBUG_USART1_TX DDRD, PORTD, 3
+#elif defined(__AVR_ATmega328P__)
+#define DEBUG_USART0_TX DDRD, PORTD, 1
+#elif defined(__AVR_ATmega2560__)
+#define DEBUG_USART0_TX DDRE, PORTE, 1
+#define DEBUG_USART1_TX DDRD, PORTD, 3
+#define DEBUG_USART2_TX DDRH, PORTH, 1
+#define DEBUG_USART3_TX DDRJ, PORTJ, 1
+#endif
+
+#define DEBUG_USART_TX_IDLE(ddr, port, bit) { ddr |= (1 << (bit)); port |= (1 << (bit)); }
+
+// What a register accessor returns: the register itself as an lvalue on AVR. A host
+// build whose <avr/io.h> maps registers onto proxy objects defines the proxy type.
+#ifndef DEBUG_USART_REGISTER
+#define DEBUG_USART_REGISTER volatile uint8_t &
+#endif
+
+template <uint8_t N>
+struct debugUsart;
+
+// -----------------------------------------------------------------------------------
+// Port traits definition
+// -----------------------------------------------------------------------------------
+// n          - USART number
+// txIdleBody - Statement that drives the TX pin high as an output, or {} if unknown
+// Register accessors return the register itself (DEBUG_USART_REGISTER), so
+// debugUsart<1>::ucsrb() |= x is exactly UCSR1B |= x. txIdle() keeps the line at the
+// idle (mark) level whenever the transmitter is disabled, e.g. before sleeping, instead
+// of leaving it floating and producing false start bits on the receiver.
+// -----------------------------------------------------------------------------------
+#define DEBUG_USART_TRAITS(n, txIdleBody) \
+template <> \
+struct debugUsart<n> { \
+    static inline DEBUG_USART_REGISTER ubrrh() { return UBRR##n##H; } \
+    static inline DEBUG_USART_REGISTER ubrrl() { return UBRR##n##L; } \
+    static inline DEBUG_USART_REGISTER ucsra() { return UCSR##n##A; } \
+    static inline DEBUG_USART_REGISTER ucsrb() { return UCSR##n##B; } \
+    static inline DEBUG_USART_REGISTER ucsrc() { return UCSR##n##C; } \
+    static inline DEBUG_USART_REGISTER udr() { return UDR##n; } \
+    static inline void txIdle() txIdleBody \
+    enum { \
+        u2x = U2X##n, udre = UDRE##n, txc = TXC##n, \
+        txen = TXEN##n, udrie = UDRIE##n, \
+        ucsz0 = UCSZ##n##0, ucsz1 = UCSZ##n##1 \
+    }; \
+};
+
+#define DEBUG_USART_TX_IDLE_OF(pin) DEBUG_USART_TX_IDLE(pin)
+
+#if defined(UDR0)
+#if defined(DEBUG_USART0_TX)
+DEBUG_USART_TRAITS(0, DEBUG_USART_TX_IDLE_OF(DEBUG_USART0_TX))
+#else
+DEBUG_USART_TRAITS(0, {})
+#endif
+#endif
+
+#if defined(UDR1)
+#if defined(DEBUG_USART1_TX)
+DEBUG_USART_TRAITS(1, DEBUG_USART_TX_IDLE_OF(DEBUG_USART1_TX))
+#else
+DEBUG_USART_TRAITS(1, {})
+#endif
+#endif
+
+#if defined(UDR2)
+#if defined(DEBUG_USART2_TX)
+DEBUG_USART_TRAITS(2, DEBUG_USART_TX_IDLE_OF(DEBUG_USART2_TX))
+#else
+DEBUG_USART_TRAITS(2, {})
+#endif
+#endif
+
+#if defined(UDR3)
+#if defined(DEBUG_USART3_TX)
+DEBUG_USART_TRAITS(3, DEBUG_USART_TX_IDLE_OF(DEBUG_USART3_TX))
+#else
+DEBUG_USART_TRAITS(3, {})
+#endif
+#endif
+
+#endif /* DEBUGUSART_H_ */
@@ -24,13 +24,14 @@ int main(void) {
     
     // Example usage
     debugPrintln("Debug Serial Library Test"); // Print string with newline
-    debugPrint("Integer: ");
+    debugPrintln_P(DEBUG_STR("Stored in flash")); // Literal kept in flash, not SRAM
+    debugPrint_P(DEBUG_STR("Integer: "));
     debugPrintIntln(12345); // Print positive integer with newline
-    debugPrint("Negative Integer: ");
+    debugPrint_P(DEBUG_STR("Negative Integer: "));
     debugPrintIntln(-6789); // Print negative integer with newline
-    debugPrint("Float: ");
+    debugPrint_P(DEBUG_STR("Float: "));
     debugPrintFloatln(3.14159, 3); // Print float with 3 decimal places and newline
-    debugPrint("No Decimals: ");
+    debugPrint_P(DEBUG_STR("No Decimals: "));
     debugPrintFloatln(42.718, 0); // Print float with no decimals and newline
     
     while (1) {
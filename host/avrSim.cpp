@@ -0,0 +1,480 @@
+/*
+ * avrSim.cpp
+ *
+ * Implementation of the host-side ATmega328PB register emulator. See avrSim.h.
+ */
+
+#include "avrSim.h"
+
+#include <vector>
+
+// Interrupt vectors provided by the code under test. Declared weak so a build that
+// does not use a given USART still links.
+extern "C" void USART0_UDRE_vect(void) __attribute__((weak));
+extern "C" void USART1_UDRE_vect(void) __attribute__((weak));
+extern "C" void TIMER1_OVF_vect(void) __attribute__((weak));
+
+#define SIM_SREG_I   7
+#define SIM_U2X      1
+#define SIM_UDRE     5
+#define SIM_TXC      6
+#define SIM_TXEN     3
+#define SIM_UDRIE    5
+#define SIM_CS1_MASK 0x07
+#define SIM_TOV1     0
+#define SIM_TOIE1    0
+
+typedef struct {
+    uint8_t ubrrh;
+    uint8_t ubrrl;
+    uint8_t ucsra;
+    uint8_t ucsrb;
+    uint8_t ucsrc;
+    void (*vector)(void);
+} simUsartRegs_t;
+
+typedef struct {
+    bool bufferFull;        // UDRn holds a byte waiting for the shift register
+    uint8_t bufferData;
+    bool shifting;          // Shift register is busy
+    uint8_t shiftData;
+    uint64_t shiftEnd;      // Cycle at which the current frame finishes
+    uint32_t isrCount;
+    std::vector<uint8_t> captured;
+} simUsartState_t;
+
+static uint8_t simSreg;
+static uint8_t simDdrD;
+static uint8_t simPortD;
+static uint64_t simNow;
+static uint8_t simTccr1a;
+static uint8_t simTccr1b;
+static uint16_t simTcnt1Base;   // TCNT1 at simTcnt1Since
+static uint64_t simTcnt1Since;  // Cycle of the last TCNT1 write or prescaler change
+static uint8_t simTemp1;        // 16-bit access latch (high byte)
+static uint8_t simTifr1;
+static uint8_t simTimsk1;
+static uint32_t simTimer1Overflows;
+static bool simInIsr;
+static simUsartRegs_t simRegs[AVR_SIM_USART_COUNT];
+static simUsartState_t simState[AVR_SIM_USART_COUNT];
+
+// -----------------------------------------------------------------------------------
+// Frame duration procedure
+// -----------------------------------------------------------------------------------
+// Input : uint8_t usart - USART index (0 or 1)
+// Output: uint32_t - CPU cycles needed to shift out one 8N1 frame (10 bits)
+// Derives the bit period from UBRRn and U2Xn exactly as the hardware baud generator
+// does: (UBRRn + 1) * 8 cycles per bit in double-speed mode, * 16 otherwise.
+// -----------------------------------------------------------------------------------
+uint32_t avrSimFrameCycles(uint8_t usart) {
+    simUsartRegs_t *r = &simRegs[usart];
+    uint32_t ubrr = ((uint32_t)(r->ubrrh & 0x0F) << 8) | r->ubrrl;
+    uint32_t divisor = (r->ucsra & (1 << SIM_U2X)) ? 8 : 16;
+    return 10 * divisor * (ubrr + 1);
+}
+
+// -----------------------------------------------------------------------------------
+// Transmitter state update procedure
+// -----------------------------------------------------------------------------------
+// Input : uint8_t usart - USART index (0 or 1)
+// Output: void
+// Completes every frame whose end time has passed, capturing the transmitted byte,
+// moving a pending UDRn byte into the shift register (setting UDREn) or, when nothing
+// is pending, setting TXCn.
+// -----------------------------------------------------------------------------------
+static void sim_usart_update(uint8_t usart) {
+    simUsartRegs_t *r = &simRegs[usart];
+    simUsartState_t *s = &simState[usart];
+
+    while (s->shifting && simNow >= s->shiftEnd) {
+        s->captured.push_back(s->shiftData);
+        if (s->bufferFull) {
+            s->shiftData = s->bufferData;
+            s->bufferFull = false;
+            s->shiftEnd += avrSimFrameCycles(usart);
+            r->ucsra |= (1 << SIM_UDRE);
+        } else {
+            s->shifting = false;
+            r->ucsra |= (1 << SIM_TXC);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Timer1 prescaler procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: uint16_t - CPU cycles per TCNT1 step for CS1[2:0] (1, 8, 64, 256, 1024), or
+//                    0 if the timer is stopped or clocked externally (never ticked here)
+// -----------------------------------------------------------------------------------
+static uint16_t sim_timer1_divisor(void) {
+    static const uint16_t prescale[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+    return prescale[simTccr1b & SIM_CS1_MASK];
+}
+
+// -----------------------------------------------------------------------------------
+// Timer1 state update procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: void
+// Adds the whole timer steps since the last update to TCNT1, keeping the fraction of a
+// step for next time, and sets TOV1 when the count wrapped past 0xFFFF.
+// -----------------------------------------------------------------------------------
+static void sim_timer1_update(void) {
+    uint16_t div = sim_timer1_divisor();
+    if (div == 0) {
+        simTcnt1Since = simNow;
+        return;
+    }
+    uint64_t steps = (simNow - simTcnt1Since) / div;
+    uint64_t count = simTcnt1Base + steps;
+    if (count > 0xFFFF) {
+        simTifr1 |= (1 << SIM_TOV1);
+    }
+    simTcnt1Base = (uint16_t)count;
+    simTcnt1Since += steps * div;
+}
+
+// -----------------------------------------------------------------------------------
+// Timer1 next overflow procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: uint64_t - Cycle at which TCNT1 next wraps, or UINT64_MAX if it is stopped
+// -----------------------------------------------------------------------------------
+static uint64_t sim_timer1_next_overflow(void) {
+    uint16_t div = sim_timer1_divisor();
+    if (div == 0) {
+        return UINT64_MAX;
+    }
+    return simTcnt1Since + (0x10000ULL - simTcnt1Base) * div;
+}
+
+// -----------------------------------------------------------------------------------
+// Interrupt dispatch procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: void
+// Brings Timer1 and both transmitters up to date, then runs TIMER1_OVF_vect while the
+// global interrupt flag, TOIE1 and TOV1 are set, and USARTn_UDRE_vect for as long as
+// the global interrupt flag, UDRIEn and UDREn are all set. The I flag is cleared while the
+// handler runs and restored afterwards, mirroring the hardware entry/RETI sequence.
+// -----------------------------------------------------------------------------------
+static void sim_dispatch(void) {
+    if (simInIsr) {
+        return;
+    }
+    bool serviced;
+    do {
+        serviced = false;
+        sim_timer1_update();
+        if ((simSreg & (1 << SIM_SREG_I)) && (simTimsk1 & (1 << SIM_TOIE1)) &&
+            (simTifr1 & (1 << SIM_TOV1)) && TIMER1_OVF_vect) {
+            simInIsr = true;
+            simSreg &= ~(1 << SIM_SREG_I);
+            simTifr1 &= ~(1 << SIM_TOV1);     // Cleared by executing the vector
+            simNow += AVR_SIM_ISR_OVERHEAD_CYCLES;
+            simTimer1Overflows++;
+            TIMER1_OVF_vect();
+            simSreg |= (1 << SIM_SREG_I);
+            simInIsr = false;
+            serviced = true;
+            continue;
+        }
+        for (uint8_t u = 0; u < AVR_SIM_USART_COUNT; u++) {
+            sim_usart_update(u);
+            simUsartRegs_t *r = &simRegs[u];
+            if ((simSreg & (1 << SIM_SREG_I)) && (r->ucsrb & (1 << SIM_UDRIE)) &&
+                (r->ucsra & (1 << SIM_UDRE)) && r->vector) {
+                simInIsr = true;
+                simSreg &= ~(1 << SIM_SREG_I);
+                simNow += AVR_SIM_ISR_OVERHEAD_CYCLES;
+                simState[u].isrCount++;
+                r->vector();
+                simSreg |= (1 << SIM_SREG_I);
+                simInIsr = false;
+                serviced = true;
+            }
+        }
+    } while (serviced);
+}
+
+// -----------------------------------------------------------------------------------
+// UDRn write procedure
+// -----------------------------------------------------------------------------------
+// Input : uint8_t usart - USART index (0 or 1)
+// Input : uint8_t value - Byte written to UDRn
+// Output: void
+// Starts a frame immediately when the shift register is idle, otherwise parks the byte
+// in the UDRn buffer and clears UDREn. Writes while TXENn is off or while the buffer
+// is already full are lost, as on hardware.
+// -----------------------------------------------------------------------------------
+static void sim_udr_write(uint8_t usart, uint8_t value) {
+    simUsartRegs_t *r = &simRegs[usart];
+    simUsartState_t *s = &simState[usart];
+
+    sim_usart_update(usart);
+    if (!(r->ucsrb & (1 << SIM_TXEN)) || s->bufferFull) {
+        return;
+    }
+    if (!s->shifting) {
+        s->shifting = true;
+        s->shiftData = value;
+        s->shiftEnd = simNow + avrSimFrameCycles(usart);
+    } else {
+        s->bufferFull = true;
+        s->bufferData = value;
+        r->ucsra &= ~(1 << SIM_UDRE);
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Register read procedure
+// -----------------------------------------------------------------------------------
+// Input : uint8_t reg - Emulated register index (AVR_SIM_*)
+// Output: uint8_t - Current register value
+// Charges the access cost to the simulated clock, services any interrupt that became
+// due, and returns the register contents. UDRn reads return 0 (transmit-only model).
+// Reading TCNT1L latches the high byte into TEMP for the following TCNT1H read.
+// -----------------------------------------------------------------------------------
+uint8_t avrSimRead(uint8_t reg) {
+    simNow += AVR_SIM_ACCESS_CYCLES;
+    sim_dispatch();
+
+    uint8_t usart = (reg >= AVR_SIM_UBRR1H) ? 1 : 0;
+    simUsartRegs_t *r = &simRegs[usart];
+    switch (reg) {
+    case AVR_SIM_SREG:
+        return simSreg;
+    case AVR_SIM_DDRD:
+        return simDdrD;
+    case AVR_SIM_PORTD:
+        return simPortD;
+    case AVR_SIM_UBRR0H: case AVR_SIM_UBRR1H:
+        return r->ubrrh;
+    case AVR_SIM_UBRR0L: case AVR_SIM_UBRR1L:
+        return r->ubrrl;
+    case AVR_SIM_UCSR0A: case AVR_SIM_UCSR1A:
+        return r->ucsra;
+    case AVR_SIM_UCSR0B: case AVR_SIM_UCSR1B:
+        return r->ucsrb;
+    case AVR_SIM_UCSR0C: case AVR_SIM_UCSR1C:
+        return r->ucsrc;
+    case AVR_SIM_TCCR1A:
+        return simTccr1a;
+    case AVR_SIM_TCCR1B:
+        return simTccr1b;
+    case AVR_SIM_TCNT1L:
+        sim_timer1_update();
+        simTemp1 = (uint8_t)(simTcnt1Base >> 8);
+        return (uint8_t)simTcnt1Base;
+    case AVR_SIM_TCNT1H:
+        return simTemp1;
+    case AVR_SIM_TIFR1:
+        sim_timer1_update();
+        return simTifr1;
+    case AVR_SIM_TIMSK1:
+        return simTimsk1;
+    default:
+        return 0;
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Register write procedure
+// -----------------------------------------------------------------------------------
+// Input : uint8_t reg - Emulated register index (AVR_SIM_*)
+// Input : uint8_t value - Value to store
+// Output: void
+// Charges the access cost, applies the write with hardware semantics (UDREn is
+// read-only, TXCn is cleared by writing a one) and services any interrupt that the
+// write made pending, e.g. setting UDRIEn or the I flag. A TCNT1H write goes to TEMP
+// and is committed together with the following TCNT1L write; TIFR1 flags are cleared
+// by writing a one.
+// -----------------------------------------------------------------------------------
+void avrSimWrite(uint8_t reg, uint8_t value) {
+    simNow += AVR_SIM_ACCESS_CYCLES;
+
+    uint8_t usart = (reg >= AVR_SIM_UBRR1H) ? 1 : 0;
+    simUsartRegs_t *r = &simRegs[usart];
+    switch (reg) {
+    case AVR_SIM_SREG:
+        simSreg = value;
+        break;
+    case AVR_SIM_DDRD:
+        simDdrD = value;
+        break;
+    case AVR_SIM_PORTD:
+        simPortD = value;
+        break;
+    case AVR_SIM_UBRR0H: case AVR_SIM_UBRR1H:
+        r->ubrrh = value;
+        break;
+    case AVR_SIM_UBRR0L: case AVR_SIM_UBRR1L:
+        r->ubrrl = value;
+        break;
+    case AVR_SIM_UCSR0A: case AVR_SIM_UCSR1A: {
+        uint8_t keep = r->ucsra & (1 << SIM_UDRE);
+        uint8_t txc = r->ucsra & (1 << SIM_TXC);
+        if (value & (1 << SIM_TXC)) {
+            txc = 0;
+        }
+        r->ucsra = keep | txc | (value & ~((1 << SIM_UDRE) | (1 << SIM_TXC)));
+        break;
+    }
+    case AVR_SIM_UCSR0B: case AVR_SIM_UCSR1B:
+        r->ucsrb = value;
+        break;
+    case AVR_SIM_UCSR0C: case AVR_SIM_UCSR1C:
+        r->ucsrc = value;
+        break;
+    case AVR_SIM_UDR0: case AVR_SIM_UDR1:
+        sim_udr_write(usart, value);
+        break;
+    case AVR_SIM_TCCR1A:
+        simTccr1a = value;
+        break;
+    case AVR_SIM_TCCR1B:
+        sim_timer1_update();
+        simTcnt1Since = simNow;
+        simTccr1b = value;
+        break;
+    case AVR_SIM_TCNT1L:
+        sim_timer1_update();
+        simTcnt1Base = (uint16_t)((simTemp1 << 8) | value);
+        simTcnt1Since = simNow;
+        break;
+    case AVR_SIM_TCNT1H:
+        simTemp1 = value;
+        break;
+    case AVR_SIM_TIFR1:
+        sim_timer1_update();
+        simTifr1 &= ~value;         // Flags are cleared by writing a one
+        break;
+    case AVR_SIM_TIMSK1:
+        simTimsk1 = value;
+        break;
+    default:
+        break;
+    }
+    sim_dispatch();
+}
+
+// -----------------------------------------------------------------------------------
+// Simulator reset procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: void
+// Restores the power-on register state (interrupts disabled, UDREn set, Timer1
+// stopped at 0), clears the simulated clock and discards all captured output.
+// -----------------------------------------------------------------------------------
+void avrSimReset(void) {
+    simSreg = 0;
+    simDdrD = 0;
+    simPortD = 0;
+    simNow = 0;
+    simInIsr = false;
+    simTccr1a = 0;
+    simTccr1b = 0;
+    simTcnt1Base = 0;
+    simTcnt1Since = 0;
+    simTemp1 = 0;
+    simTifr1 = 0;
+    simTimsk1 = 0;
+    simTimer1Overflows = 0;
+    for (uint8_t u = 0; u < AVR_SIM_USART_COUNT; u++) {
+        simRegs[u] = simUsartRegs_t();
+        simRegs[u].ucsra = (1 << SIM_UDRE);
+        simState[u] = simUsartState_t();
+    }
+    simRegs[0].vector = USART0_UDRE_vect;
+    simRegs[1].vector = USART1_UDRE_vect;
+}
+
+// -----------------------------------------------------------------------------------
+// Simulated time advance procedure
+// -----------------------------------------------------------------------------------
+// Input : uint32_t cycles - Number of CPU cycles the main context spends elsewhere
+// Output: void
+// Advances the simulated clock frame by frame, servicing UDRE interrupts as the
+// transmitters free up and, with TOIE1 set, Timer1 overflows as they occur. Models
+// application code that runs between log calls.
+// -----------------------------------------------------------------------------------
+void avrSimRun(uint32_t cycles) {
+    uint64_t target = simNow + cycles;
+    sim_dispatch();
+    while (simNow < target) {
+        uint64_t next = target;
+        if (simTimsk1 & (1 << SIM_TOIE1)) {
+            uint64_t overflow = sim_timer1_next_overflow();
+            if (overflow < next) {
+                next = overflow;
+            }
+        }
+        for (uint8_t u = 0; u < AVR_SIM_USART_COUNT; u++) {
+            if (simState[u].shifting && simState[u].shiftEnd < next) {
+                next = simState[u].shiftEnd;
+            }
+        }
+        if (next > simNow) {
+            simNow = next;
+        }
+        sim_dispatch();
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Transmitter drain procedure
+// -----------------------------------------------------------------------------------
+// Input : uint8_t usart - USART index (0 or 1)
+// Input : uint64_t maxCycles - Upper bound on simulated cycles to wait
+// Output: bool - Returns true once the USART is idle (UDRIEn off, shift register empty)
+// Runs the simulation until the interrupt-driven transmitter has nothing left to
+// send, or until maxCycles have elapsed.
+// -----------------------------------------------------------------------------------
+bool avrSimRunUntilIdle(uint8_t usart, uint64_t maxCycles) {
+    uint64_t deadline = simNow + maxCycles;
+    for (;;) {
+        sim_dispatch();
+        bool idle = !(simRegs[usart].ucsrb & (1 << SIM_UDRIE)) && !simState[usart].shifting;
+        if (idle) {
+            return true;
+        }
+        if (simNow >= deadline) {
+            return false;
+        }
+        avrSimRun(avrSimFrameCycles(usart));
+    }
+}
+
+uint64_t avrSimCycles(void) {
+    return simNow;
+}
+
+size_t avrSimTxCount(uint8_t usart) {
+    return simState[usart].captured.size();
+}
+
+const uint8_t *avrSimTxData(uint8_t usart) {
+    return simState[usart].captured.data();
+}
+
+void avrSimTxClear(uint8_t usart) {
+    simState[usart].captured.clear();
+}
+
+uint32_t avrSimIsrCount(uint8_t usart) {
+    return simState[usart].isrCount;
+}
+
+uint32_t avrSimTimer1OverflowCount(void) {
+    return simTimer1Overflows;
+}
+
+uint8_t avrSimPortD(void) {
+    return simPortD;
+}
+
+uint8_t avrSimDdrD(void) {
+    return simDdrD;
+}
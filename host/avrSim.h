@@ -0,0 +1,88 @@
+/*
+ * avrSim.h
+ *
+ * Host-side emulation of the ATmega328PB registers used by the debugSerial library.
+ *
+ * The library sources are compiled unchanged on Linux against the shim headers in
+ * host/include (avr/io.h, avr/interrupt.h), which route every register access through
+ * this emulator. The emulator models:
+ * - A simulated CPU clock that advances by a fixed cost on each register access and
+ *   by explicit calls to avrSimRun().
+ * - The status register (SREG) global interrupt flag driven by cli()/sei().
+ * - USART0 and USART1 transmitters with a one-byte UDRn buffer, a shift register, the
+ *   UDREn/TXCn flags and frame timing derived from UBRRn and U2Xn (8N1, 10 bits/frame).
+ * - The USARTn_UDRE_vect interrupts, dispatched whenever the global interrupt flag,
+ *   UDRIEn and UDREn are all set.
+ * - DDRD and PORTD as plain storage, for the USART TX pins (PD1, PD3).
+ * - Timer/Counter1 in normal mode: TCNT1 counts the simulated clock through the
+ *   CS1[2:0] prescaler and is read and written through the TEMP high-byte latch
+ *   (low byte first on reads, high byte first on writes). Wrapping from 0xFFFF sets
+ *   TOV1 in TIFR1, and TIMER1_OVF_vect is dispatched when TOIE1 and the I flag are
+ *   set; it takes priority over the USARTs, as on the part. TCCR1A is plain storage.
+ *
+ * Bytes shifted out on each USART are captured so benchmarks and host tools can
+ * inspect exactly what would have appeared on the TX pin.
+ */
+
+#ifndef AVRSIM_H_
+#define AVRSIM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Emulated register indices
+enum {
+    AVR_SIM_SREG = 0,
+    AVR_SIM_UBRR0H,
+    AVR_SIM_UBRR0L,
+    AVR_SIM_UCSR0A,
+    AVR_SIM_UCSR0B,
+    AVR_SIM_UCSR0C,
+    AVR_SIM_UDR0,
+    AVR_SIM_UBRR1H,
+    AVR_SIM_UBRR1L,
+    AVR_SIM_UCSR1A,
+    AVR_SIM_UCSR1B,
+    AVR_SIM_UCSR1C,
+    AVR_SIM_UDR1,
+    AVR_SIM_DDRD,
+    AVR_SIM_PORTD,
+    AVR_SIM_TCCR1A,
+    AVR_SIM_TCCR1B,
+    AVR_SIM_TCNT1L,
+    AVR_SIM_TCNT1H,
+    AVR_SIM_TIFR1,
+    AVR_SIM_TIMSK1,
+    AVR_SIM_REGISTER_COUNT
+};
+
+#define AVR_SIM_USART_COUNT 2
+
+// Simulated CPU cycles charged for a single register load or store
+#define AVR_SIM_ACCESS_CYCLES 2
+// Simulated CPU cycles charged for interrupt entry and exit (vector jump + RETI)
+#define AVR_SIM_ISR_OVERHEAD_CYCLES 10
+
+// Register access (used by the shim headers)
+uint8_t avrSimRead(uint8_t reg);
+void avrSimWrite(uint8_t reg, uint8_t value);
+
+// Simulation control
+void avrSimReset(void);
+void avrSimRun(uint32_t cycles);
+bool avrSimRunUntilIdle(uint8_t usart, uint64_t maxCycles);
+uint64_t avrSimCycles(void);
+uint32_t avrSimFrameCycles(uint8_t usart);
+
+// Captured TX output
+size_t avrSimTxCount(uint8_t usart);
+const uint8_t *avrSimTxData(uint8_t usart);
+void avrSimTxClear(uint8_t usart);
+uint32_t avrSimIsrCount(uint8_t usart);
+uint32_t avrSimTimer1OverflowCount(void);
+
+// Port D state
+uint8_t avrSimPortD(void);
+uint8_t avrSimDdrD(void);
+
+#endif /* AVRSIM_H_ */
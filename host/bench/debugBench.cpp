@@ -0,0 +1,383 @@
+/*
+ * debugBench.cpp
+ *
+ * Host benchmark for the debugSerial library running against the emulated ATmega328PB
+ * USART (host/avrSim.cpp).
+ *
+ * Usage: debugBench [baud] [iterations]
+ *
+ * Reports two kinds of numbers:
+ * - Host nanoseconds (and x86 TSC cycles) per call of each hot-path function (library + register emulation
+ *   overhead). Use them to compare revisions on the same machine, not as AVR timings.
+ *   The float conversion rows time the formatter alone, against the legacy loop.
+ * - Simulated wire statistics for a periodic logging workload at the given baud:
+ *   bytes requested versus bytes actually shifted out, and the resulting drop rate.
+ */
+
+#include "debugSerial.h"
+#include "avrSim.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_HAVE_TSC 1
+#else
+#define BENCH_HAVE_TSC 0
+#endif
+
+#define BENCH_UART 1
+#define BENCH_DRAIN_CYCLES 100000000ULL
+
+static int32_t benchBaud = 115200;
+static uint32_t benchIterations = 20000;
+
+typedef void (*benchBody_t)(uint32_t i);
+
+// -----------------------------------------------------------------------------------
+// Host clock procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: uint64_t - Monotonic host time in nanoseconds
+// -----------------------------------------------------------------------------------
+static uint64_t bench_now_ns(void) {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// -----------------------------------------------------------------------------------
+// Host cycle counter procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: uint64_t - Host time-stamp counter (x86), or 0 where none is available
+// -----------------------------------------------------------------------------------
+static uint64_t bench_ticks(void) {
+#if BENCH_HAVE_TSC
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+// -----------------------------------------------------------------------------------
+// Benchmark setup procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: void
+// Resets the emulator and re-initialises the library at the benchmark baud rate.
+// -----------------------------------------------------------------------------------
+static void bench_begin(void) {
+    avrSimReset();
+    debugSerialBegin(benchBaud);
+}
+
+// -----------------------------------------------------------------------------------
+// Transmitter drain procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: void
+// Lets the simulated USART send everything that is queued.
+// -----------------------------------------------------------------------------------
+static void bench_drain(void) {
+    avrSimRunUntilIdle(BENCH_UART, BENCH_DRAIN_CYCLES);
+}
+
+// -----------------------------------------------------------------------------------
+// Call latency measurement procedure
+// -----------------------------------------------------------------------------------
+// Input : const char *name - Label printed in the report
+// Input : benchBody_t body - Code under test; must enqueue less than one buffer's worth
+// Output: void
+// Times body() for benchIterations rounds, draining the transmitter (untimed) after
+// each round so the ring buffer never overflows. Reports host ns per call and the
+// number of bytes each call produced on the wire.
+// -----------------------------------------------------------------------------------
+static void bench_latency(const char *name, benchBody_t body) {
+    bench_begin();
+    uint64_t total = 0;
+    for (uint32_t i = 0; i < benchIterations; i++) {
+        uint64_t start = bench_now_ns();
+        body(i);
+        total += bench_now_ns() - start;
+        bench_drain();
+    }
+    double bytesPerCall = (double)avrSimTxCount(BENCH_UART) / benchIterations;
+    printf("%-32s %10.1f ns/call %8.1f bytes/call\n", name,
+           (double)total / benchIterations, bytesPerCall);
+}
+
+// -----------------------------------------------------------------------------------
+// Integer formatting cost procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: void
+// Times debugPrintInt separately for a set of representative values (short, long,
+// negative, extremes), reporting host ns and host cycles (x86 TSC) per call. The digit
+// count dominates the cost, so each row shows how the formatter scales with length.
+// Both are host timings: the x86 divides and multiplies in one instruction what the
+// AVR does in a library call, so the rows are not AVR cycle counts. Use DEBUG_PROFILE
+// on the target for those.
+// -----------------------------------------------------------------------------------
+static void bench_int_values(void) {
+    static const int32_t values[] = { 0, 7, -42, 1234, 65535, -6789012, 2147483647, INT32_MIN };
+    for (size_t v = 0; v < sizeof(values) / sizeof(values[0]); v++) {
+        bench_begin();
+        uint64_t total = 0;
+        uint64_t ticks = 0;
+        for (uint32_t i = 0; i < benchIterations; i++) {
+            uint64_t start = bench_now_ns();
+            uint64_t startTicks = bench_ticks();
+            debugPrintInt(values[v]);
+            ticks += bench_ticks() - startTicks;
+            total += bench_now_ns() - start;
+            bench_drain();
+        }
+        char label[40];
+        snprintf(label, sizeof(label), "debugPrintInt(%ld)", (long)values[v]);
+        printf("%-32s %10.1f ns/call %8.0f x86 TSC cycles/call\n", label,
+               (double)total / benchIterations, (double)ticks / benchIterations);
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// ISR drain measurement procedure
+// -----------------------------------------------------------------------------------
+// Input : None
+// Output: void
+// Queues one line, then times how long the emulated UDRE interrupt takes to empty the
+// ring buffer. Reports host ns and simulated cycles per transmitted byte.
+// -----------------------------------------------------------------------------------
+static void bench_isr(void) {
+    bench_begin();
+    uint64_t total = 0;
+    uint64_t cycles = 0;
+    for (uint32_t i = 0; i < benchIterations; i++) {
+        debugPrint("ISR drain benchmark payload line");
+        uint64_t startCycles = avrSimCycles();
+        uint64_t start = bench_now_ns();
+        bench_drain();
+        total += bench_now_ns() - start;
+        cycles += avrSimCycles() - startCycles;
+    }
+    double bytes = (double)avrSimTxCount(BENCH_UART);
+    printf("%-32s %10.1f ns/byte %8.1f sim cycles/byte (%u ISR calls)\n", "USART1_UDRE_vect drain",
+           (double)total / bytes, (double)cycles / bytes, avrSimIsrCount(BENCH_UART));
+}
+
+// -----------------------------------------------------------------------------------
+// Wire throughput measurement procedure
+// -----------------------------------------------------------------------------------
+// Input : uint32_t periodCycles - Simulated CPU cycles between two log lines
+// Output: void
+// Models a control loop that logs one line every periodCycles. Compares bytes
+// requested with bytes shifted out to expose drops caused by a full ring buffer.
+// -----------------------------------------------------------------------------------
+static void bench_throughput(uint32_t periodCycles) {
+    bench_begin();
+    uint64_t requested = 0;
+    uint64_t startCycles = avrSimCycles();
+    for (uint32_t i = 0; i < benchIterations; i++) {
+        debugPrint("loop=");
+        debugPrintIntln((int32_t)i);
+        requested += 5 + 2;
+        for (uint32_t v = i; v >= 10; v /= 10) {
+            requested++;
+        }
+        requested++;
+        avrSimRun(periodCycles);
+    }
+    bench_drain();
+    double seconds = (double)(avrSimCycles() - startCycles) / F_CPU;
+    uint64_t sent = avrSimTxCount(BENCH_UART);
+    printf("loop period %7u cycles: %9llu requested %9llu sent %6.2f%% dropped %8.0f bytes/s\n",
+           periodCycles, (unsigned long long)requested, (unsigned long long)sent,
+           100.0 * (double)(requested - sent) / (double)requested, (double)sent / seconds);
+}
+
+static void body_print_line(uint32_t) {
+    debugPrintln("Temperature sensor reading ok");
+}
+
+static void body_print_line_P(uint32_t) {
+    debugPrintln_P(DEBUG_STR("Temperature sensor reading ok"));
+}
+
+static void body_chained_line(uint32_t i) {
+    debugPrint_P(DEBUG_STR("temp="));
+    debugPrintFloat(21.5f, 2);
+    debugPrint_P(DEBUG_STR(" rpm="));
+    debugPrintIntln((int32_t)(1500 + (i & 0xFF)));
+}
+
+static void body_log_line(uint32_t i) {
+    debugLog(DEBUG_F("temp="), 21.5f, DEBUG_F(" rpm="), (int32_t)(1500 + (i & 0xFF)));
+}
+
+static void body_token_line(uint32_t i) {
+    DEBUG_TOKEN_LOG("temp=%.2f rpm=%d", 21.5f, (int32_t)(1500 + (i & 0xFF)));
+}
+
+static void body_log_status(uint32_t i) {
+    debugLog(DEBUG_F("Motor controller: temperature "), 21.5f, DEBUG_F(" C, rpm "),
+             (int32_t)(1500 + (i & 0xFF)));
+}
+
+static void body_token_status(uint32_t i) {
+    DEBUG_TOKEN_LOG("Motor controller: temperature %.2f C, rpm %d", 21.5f, (int32_t)(1500 + (i & 0xFF)));
+}
+
+// Slowly varying 12-bit sensor reading
+static int32_t bench_sensor(uint32_t i) {
+    return 2048 + (int32_t)((i * 7) % 61) - 30;
+}
+
+static void body_sensor_text(uint32_t i) {
+    debugPrintIntln(bench_sensor(i));
+}
+
+static void body_sensor_telemetry(uint32_t i) {
+    debugTelemetrySample(0, bench_sensor(i));
+}
+
+static void body_print_int(uint32_t i) {
+    static const int32_t values[] = { 0, 7, -42, 12345, -6789, 2147483647, -1000000 };
+    debugPrintInt(values[i % (sizeof(values) / sizeof(values[0]))]);
+}
+
+static void body_print_uint64(uint32_t i) {
+    debugPrintUInt64(1752000000000000ULL + i);
+}
+
+static void body_print_float(uint32_t) {
+    debugPrintFloat(3.14159f, 3);
+}
+
+// -----------------------------------------------------------------------------------
+// Reference float formatter (pre fixed-point implementation)
+// -----------------------------------------------------------------------------------
+// Input : debugLogLine_t *line - Line buffer that receives the text
+// Input : float value - The floating-point number to format
+// Input : uint8_t decimalPlaces - Number of decimal places to display
+// Output: void
+// The original per-digit multiply/convert/subtract loop, writing into the same stack
+// line buffer as debugLogAppendFloat so the two differ only in the conversion.
+// -----------------------------------------------------------------------------------
+static void bench_legacy_format_float(debugLogLine_t *line, float value, uint8_t decimalPlaces) {
+    if (value < 0) {
+        debugLogAppendChar(line, '-');
+        value = -value;
+    }
+    int32_t intPart = (int32_t)value;
+    debugLogAppendInt(line, intPart);
+    if (decimalPlaces > 0) {
+        debugLogAppendChar(line, '.');
+        float decimalPart = value - intPart;
+        for (uint8_t i = 0; i < decimalPlaces; i++) {
+            decimalPart *= 10;
+            int digit = (int)decimalPart;
+            debugLogAppendChar(line, (char)('0' + digit));
+            decimalPart -= digit;
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Float conversion measurement procedure
+// -----------------------------------------------------------------------------------
+// Input : const char *name - Label printed in the report
+// Input : float value - The floating-point number to format
+// Input : uint8_t decimalPlaces - Number of decimal places to display
+// Output: void
+// Times only the conversion into a stack line buffer, nothing is queued: the
+// fixed-point debugLogAppendFloat (the formatter behind debugPrintFloat) against the
+// legacy loop. The host has hardware floats, so the ratio says how many float
+// operations each method does, not what they cost in AVR soft-float code.
+// -----------------------------------------------------------------------------------
+static void bench_float_format(const char *name, float value, uint8_t decimalPlaces) {
+    uint64_t total = 0;
+    uint64_t legacy = 0;
+    debugLogLine_t line;
+    for (uint32_t i = 0; i < benchIterations; i++) {
+        debugLogBegin(&line);
+        uint64_t start = bench_now_ns();
+        debugLogAppendFloat(&line, value, decimalPlaces);
+        total += bench_now_ns() - start;
+
+        debugLogBegin(&line);
+        start = bench_now_ns();
+        bench_legacy_format_float(&line, value, decimalPlaces);
+        legacy += bench_now_ns() - start;
+    }
+    char label[40];
+    snprintf(label, sizeof(label), "format %s", name);
+    printf("%-32s %10.1f ns/call (legacy loop %.1f ns/call)\n", label,
+           (double)total / benchIterations, (double)legacy / benchIterations);
+}
+
+static void body_print_q16(uint32_t) {
+    debugPrintQ16(-17901158, 6);     // -273.150012 in Q16.16
+}
+
+static void body_print_hex32(uint32_t i) {
+    debugPrintHex32(0xDEAD0000UL + i);
+}
+
+static void body_hexdump(uint32_t i) {
+    uint8_t frame[16];
+    for (uint8_t b = 0; b < sizeof(frame); b++) {
+        frame[b] = (uint8_t)(i + b);
+    }
+    debugHexDump(frame, sizeof(frame));
+}
+
+static void body_print_float6(uint32_t) {
+    debugPrintFloat(-273.150012f, 6);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1) {
+        benchBaud = (int32_t)strtol(argv[1], NULL, 10);
+    }
+    if (argc > 2) {
+        benchIterations = (uint32_t)strtoul(argv[2], NULL, 10);
+    }
+
+    printf("debugSerial host benchmark: F_CPU=%lu baud=%ld iterations=%u\n\n",
+           (unsigned long)F_CPU, (long)benchBaud, benchIterations);
+
+    bench_latency("debugPrintln(30 chars)", body_print_line);
+    bench_latency("debugPrintln_P(30 chars)", body_print_line_P);
+    bench_latency("4 chained debugPrint* calls", body_chained_line);
+    bench_latency("debugLog(same line)", body_log_line);
+    bench_latency("DEBUG_TOKEN_LOG(same line)", body_token_line);
+    bench_latency("debugLog(status line)", body_log_status);
+    bench_latency("DEBUG_TOKEN_LOG(status line)", body_token_status);
+    bench_latency("debugPrintIntln(sensor)", body_sensor_text);
+    bench_latency("debugTelemetrySample(sensor)", body_sensor_telemetry);
+    bench_latency("debugPrintInt", body_print_int);
+    bench_latency("debugPrintUInt64(timestamp)", body_print_uint64);
+    bench_latency("debugPrintFloat(3.14159, 3)", body_print_float);
+    bench_latency("debugPrintFloat(-273.15, 6)", body_print_float6);
+    bench_latency("debugPrintQ16(-273.15, 6)", body_print_q16);
+    bench_latency("debugPrintHex32", body_print_hex32);
+    bench_latency("debugHexDump(16 bytes)", body_hexdump);
+    bench_isr();
+    printf("\n");
+
+    printf("Integer formatting (host timings, not AVR cycles):\n");
+    bench_int_values();
+    printf("\n");
+
+    printf("Float conversion only (host floats, not AVR soft-float cost):\n");
+    bench_float_format("(3.14159, 3)", 3.14159f, 3);
+    bench_float_format("(-273.15, 6)", -273.150012f, 6);
+    printf("\n");
+
+    bench_throughput(16000);
+    bench_throughput(4000);
+    bench_throughput(1000);
+    return 0;
+}
@@ -0,0 +1,19 @@
+/*
+ * avr/interrupt.h (host shim)
+ *
+ * Stand-in for <avr/interrupt.h> when building the debugSerial library on a Linux
+ * host. cli()/sei() drive the emulated SREG I flag, and ISR() defines a plain
+ * C-linkage function that the register emulator calls when the interrupt is due.
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+#include "io.h"
+
+#define cli() (SREG &= (uint8_t)~_BV(SREG_I))
+#define sei() (SREG |= (uint8_t)_BV(SREG_I))
+
+#define ISR(vector) extern "C" void vector(void)
+
+#endif /* HOST_AVR_INTERRUPT_H_ */
@@ -0,0 +1,201 @@
+/*
+ * avr/io.h (host shim)
+ *
+ * Stand-in for <avr/io.h> when building the debugSerial library on a Linux host.
+ * Each I/O register name expands to a proxy object whose loads and stores are routed
+ * to the register emulator in host/avrSim.cpp, so the library sources compile
+ * unchanged and behave like they would against an ATmega328PB.
+ */
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+#include "../../avrSim.h"
+
+// The emulated part, as avr-gcc -mmcu=atmega328pb would define it
+#ifndef __AVR_ATmega328PB__
+#define __AVR_ATmega328PB__
+#endif
+
+// Interrupt vector names are macros in avr-libc; here they name the handler functions
+// avrSim.cpp calls
+#define USART0_UDRE_vect USART0_UDRE_vect
+#define USART1_UDRE_vect USART1_UDRE_vect
+#define TIMER1_OVF_vect  TIMER1_OVF_vect
+
+// Proxy for a single emulated 8-bit I/O register
+class avrSimRegister {
+public:
+    explicit avrSimRegister(uint8_t reg) : reg_(reg) {}
+
+    operator uint8_t() const { return avrSimRead(reg_); }
+
+    const avrSimRegister &operator=(uint8_t value) const {
+        avrSimWrite(reg_, value);
+        return *this;
+    }
+    const avrSimRegister &operator|=(uint8_t value) const {
+        avrSimWrite(reg_, avrSimRead(reg_) | value);
+        return *this;
+    }
+    const avrSimRegister &operator&=(uint8_t value) const {
+        avrSimWrite(reg_, avrSimRead(reg_) & value);
+        return *this;
+    }
+    const avrSimRegister &operator^=(uint8_t value) const {
+        avrSimWrite(reg_, avrSimRead(reg_) ^ value);
+        return *this;
+    }
+
+private:
+    uint8_t reg_;
+};
+
+// Proxy for an emulated 16-bit register pair, accessed in the order avr-gcc emits:
+// low byte first on reads, high byte first on writes (the TEMP latch protocol)
+class avrSimRegister16 {
+public:
+    explicit avrSimRegister16(uint8_t regLow) : reg_(regLow) {}
+
+    operator uint16_t() const {
+        uint8_t low = avrSimRead(reg_);
+        return (uint16_t)(low | (avrSimRead(reg_ + 1) << 8));
+    }
+
+    const avrSimRegister16 &operator=(uint16_t value) const {
+        avrSimWrite(reg_ + 1, (uint8_t)(value >> 8));
+        avrSimWrite(reg_, (uint8_t)value);
+        return *this;
+    }
+
+private:
+    uint8_t reg_;
+};
+
+// Register accessors in debugUsart.h return the proxy by value
+#define DEBUG_USART_REGISTER avrSimRegister
+
+#ifndef _BV
+#define _BV(bit) (1 << (bit))
+#endif
+
+#define SREG    (avrSimRegister(AVR_SIM_SREG))
+#define SREG_C  0
+#define SREG_Z  1
+#define SREG_N  2
+#define SREG_V  3
+#define SREG_S  4
+#define SREG_H  5
+#define SREG_T  6
+#define SREG_I  7
+
+// Port D (USART0 TX on PD1, USART1 TX on PD3)
+#define DDRD    (avrSimRegister(AVR_SIM_DDRD))
+#define PORTD   (avrSimRegister(AVR_SIM_PORTD))
+
+// USART0
+#define UBRR0H  (avrSimRegister(AVR_SIM_UBRR0H))
+#define UBRR0L  (avrSimRegister(AVR_SIM_UBRR0L))
+#define UCSR0A  (avrSimRegister(AVR_SIM_UCSR0A))
+#define UCSR0B  (avrSimRegister(AVR_SIM_UCSR0B))
+#define UCSR0C  (avrSimRegister(AVR_SIM_UCSR0C))
+#define UDR0    (avrSimRegister(AVR_SIM_UDR0))
+
+#define MPCM0   0
+#define U2X0    1
+#define UPE0    2
+#define DOR0    3
+#define FE0     4
+#define UDRE0   5
+#define TXC0    6
+#define RXC0    7
+
+#define TXB80   0
+#define RXB80   1
+#define UCSZ02  2
+#define TXEN0   3
+#define RXEN0   4
+#define UDRIE0  5
+#define TXCIE0  6
+#define RXCIE0  7
+
+#define UCPOL0  0
+#define UCSZ00  1
+#define UCSZ01  2
+#define USBS0   3
+#define UPM00   4
+#define UPM01   5
+#define UMSEL00 6
+#define UMSEL01 7
+
+// USART1
+#define UBRR1H  (avrSimRegister(AVR_SIM_UBRR1H))
+#define UBRR1L  (avrSimRegister(AVR_SIM_UBRR1L))
+#define UCSR1A  (avrSimRegister(AVR_SIM_UCSR1A))
+#define UCSR1B  (avrSimRegister(AVR_SIM_UCSR1B))
+#define UCSR1C  (avrSimRegister(AVR_SIM_UCSR1C))
+#define UDR1    (avrSimRegister(AVR_SIM_UDR1))
+
+#define MPCM1   0
+#define U2X1    1
+#define UPE1    2
+#define DOR1    3
+#define FE1     4
+#define UDRE1   5
+#define TXC1    6
+#define RXC1    7
+
+#define TXB81   0
+#define RXB81   1
+#define UCSZ12  2
+#define TXEN1   3
+#define RXEN1   4
+#define UDRIE1  5
+#define TXCIE1  6
+#define RXCIE1  7
+
+#define UCPOL1  0
+#define UCSZ10  1
+#define UCSZ11  2
+#define USBS1   3
+#define UPM10   4
+#define UPM11   5
+#define UMSEL10 6
+#define UMSEL11 7
+
+// Timer/Counter1
+#define TCCR1A  (avrSimRegister(AVR_SIM_TCCR1A))
+#define TCCR1B  (avrSimRegister(AVR_SIM_TCCR1B))
+#define TCNT1L  (avrSimRegister(AVR_SIM_TCNT1L))
+#define TCNT1H  (avrSimRegister(AVR_SIM_TCNT1H))
+#define TCNT1   (avrSimRegister16(AVR_SIM_TCNT1L))
+#define TIFR1   (avrSimRegister(AVR_SIM_TIFR1))
+#define TIMSK1  (avrSimRegister(AVR_SIM_TIMSK1))
+
+#define WGM10   0
+#define WGM11   1
+#define COM1B0  4
+#define COM1B1  5
+#define COM1A0  6
+#define COM1A1  7
+
+#define CS10    0
+#define CS11    1
+#define CS12    2
+#define WGM12   3
+#define WGM13   4
+#define ICES1   6
+#define ICNC1   7
+
+#define TOV1    0
+#define OCF1A   1
+#define OCF1B   2
+#define ICF1    5
+
+#define TOIE1   0
+#define OCIE1A  1
+#define OCIE1B  2
+#define ICIE1   5
+
+#endif /* HOST_AVR_IO_H_ */
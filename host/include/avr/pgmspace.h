@@ -0,0 +1,27 @@
+/*
+ * avr/pgmspace.h (host shim)
+ *
+ * Stand-in for <avr/pgmspace.h> when building the debugSerial library on a Linux
+ * host. There is a single address space on the host, so PROGMEM data stays in
+ * ordinary memory and the flash accessors become plain loads and copies.
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+
+#define pgm_read_byte(addr)  (*(const uint8_t *)(addr))
+#define pgm_read_word(addr)  (*(const uint16_t *)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t *)(addr))
+#define pgm_read_float(addr) (*(const float *)(addr))
+
+#define memcpy_P(dest, src, n) memcpy((dest), (src), (n))
+#define strlen_P(s) strlen(s)
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
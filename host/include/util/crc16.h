@@ -0,0 +1,21 @@
+/*
+ * util/crc16.h (host shim)
+ *
+ * Stand-in for <util/crc16.h> when building the debugSerial library on a Linux host.
+ * avr-libc implements these in inline assembly; this is the equivalent C code given
+ * in the avr-libc documentation, so host and target produce identical CRCs.
+ */
+
+#ifndef HOST_UTIL_CRC16_H_
+#define HOST_UTIL_CRC16_H_
+
+#include <stdint.h>
+
+// CRC-16/CCITT, reflected (polynomial 0x8408), one byte at a time
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data) {
+    data ^= (uint8_t)crc;
+    data ^= (uint8_t)(data << 4);
+    return (uint16_t)((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+
+#endif /* HOST_UTIL_CRC16_H_ */
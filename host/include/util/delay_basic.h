@@ -0,0 +1,25 @@
+/*
+ * util/delay_basic.h (host shim)
+ *
+ * Stand-in for <util/delay_basic.h> when building the debugSerial library on a Linux
+ * host. The busy-wait loops advance the emulated clock by the cycles they take on the
+ * target instead of spinning.
+ */
+
+#ifndef HOST_UTIL_DELAY_BASIC_H_
+#define HOST_UTIL_DELAY_BASIC_H_
+
+#include <stdint.h>
+#include "../../avrSim.h"
+
+// 3 cycles per iteration; a count of 0 means 256
+static inline void _delay_loop_1(uint8_t count) {
+    avrSimRun(3UL * (count ? count : 256));
+}
+
+// 4 cycles per iteration; a count of 0 means 65536
+static inline void _delay_loop_2(uint16_t count) {
+    avrSimRun(4UL * (count ? count : 65536UL));
+}
+
+#endif /* HOST_UTIL_DELAY_BASIC_H_ */
@@ -0,0 +1,810 @@
+/*
+ * debugTest.cpp
+ *
+ * Host regression tests for the debugSerial library, run by ctest.
+ *
+ * Usage: debugTest [capture]
+ *
+ * Every case calls the public API, runs the emulated UDRE interrupt until the USART is
+ * idle and compares the bytes captured on the TX pin with the expected output. With
+ * DEBUG_FRAMING=1 the capture is COBS-decoded first and every frame's CRC-16 and
+ * sequence number is checked, so the same text cases cover the framed build. With
+ * DEBUG_TIMESTAMP the line stamps are taken out of the capture before comparing; a
+ * build with DEBUG_TIMESTAMP_SOURCE reads them from a counter the stamp cases set.
+ * Token records are compared byte for byte. Telemetry and fault output is read from
+ * the channel's own USART, and the channel scheduling cases run where channels share
+ * one. If a capture file is named, a fixed text line, telemetry samples and
+ * DEBUG_TOKEN_LOG records are written to it for the debugDecode and debugDeframe round
+ * trips registered in CMakeLists.txt. Prints each failing case and exits with 1 if any
+ * failed.
+ */
+
+#include "debugSerial.h"
+#include "avrSim.h"
+
+#include <avr/interrupt.h>
+#include <util/crc16.h>
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// USARTs the telemetry and fault output leave on: the text USART when the channel has
+// no buffer of its own
+#if DEBUG_TELEMETRY_BUFFER_SIZE > 0
+#define TEST_TELEMETRY_USART DEBUG_TELEMETRY_USART
+#else
+#define TEST_TELEMETRY_USART DEBUG_USART
+#endif
+#if DEBUG_FAULT_BUFFER_SIZE > 0
+#define TEST_FAULT_USART DEBUG_FAULT_USART
+#else
+#define TEST_FAULT_USART DEBUG_USART
+#endif
+
+// Telemetry and fault channels with buffers of their own on one USART
+#define TEST_SHARED_TELEMETRY ((DEBUG_TELEMETRY_BUFFER_SIZE > 0) && (DEBUG_FAULT_BUFFER_SIZE > 0) && \
+                               (TEST_TELEMETRY_USART == TEST_FAULT_USART))
+
+static unsigned testCount;
+static unsigned testFailures;
+
+#ifdef DEBUG_TIMESTAMP_SOURCE
+static uint32_t testTicks;                          // Clock value the next stamp takes
+
+extern "C" uint32_t DEBUG_TIMESTAMP_SOURCE(void) {
+    return testTicks;
+}
+#endif
+
+#if DEBUG_FRAMING
+static bool testSynced[1 << (8 - DEBUG_FRAME_SEQ_BITS)];     // Per channel
+static uint8_t testNextSeq[1 << (8 - DEBUG_FRAME_SEQ_BITS)];
+
+// -----------------------------------------------------------------------------------
+// Frame check procedure
+// -----------------------------------------------------------------------------------
+// Input : const std::vector<uint8_t> &frame - One COBS-encoded frame, no delimiter
+// Output: std::string - The frame's data, or an empty string if the frame is corrupt
+// Decodes the frame, verifies its CRC-16 and that its sequence number follows the
+// previous frame of the same channel. Nothing is dropped in these tests, so a gap is a
+// failure.
+// -----------------------------------------------------------------------------------
+static std::string test_frame(const std::vector<uint8_t> &frame) {
+    std::vector<uint8_t> data;
+    size_t i = 0;
+    while (i < frame.size()) {
+        uint8_t code = frame[i++];
+        if (code == 0 || i + code - 1 > frame.size()) {
+            printf("FAIL frame: bad COBS code\n");
+            testFailures++;
+            return std::string();
+        }
+        data.insert(data.end(), frame.begin() + i, frame.begin() + i + code - 1);
+        i += code - 1;
+        if (code != 0xFF && i < frame.size()) {
+            data.push_back(0);
+        }
+    }
+    if (data.size() < 3) {
+        printf("FAIL frame: %u bytes\n", (unsigned)data.size());
+        testFailures++;
+        return std::string();
+    }
+    uint16_t crc = 0xFFFF;
+    for (i = 0; i < data.size() - 2; i++) {
+        crc = _crc_ccitt_update(crc, data[i]);
+    }
+    if (crc != (uint16_t)(data[data.size() - 2] | (data[data.size() - 1] << 8))) {
+        printf("FAIL frame: CRC %04X\n", crc);
+        testFailures++;
+        return std::string();
+    }
+    uint8_t channel = data[0] >> DEBUG_FRAME_SEQ_BITS;
+    uint8_t seq = data[0] & DEBUG_FRAME_SEQ_MASK;
+    if (testSynced[channel] && seq != testNextSeq[channel]) {
+        printf("FAIL frame: sequence %u, expected %u\n", seq, testNextSeq[channel]);
+        testFailures++;
+    }
+    testSynced[channel] = true;
+    testNextSeq[channel] = (seq + 1) & DEBUG_FRAME_SEQ_MASK;
+    return std::string(data.begin() + 1, data.end() - 2);
+}
+#endif
+
+// -----------------------------------------------------------------------------------
+// Transmitter drain procedure
+// -----------------------------------------------------------------------------------
+// Input : none
+// Output: void
+// Runs the emulator until every USART has sent all that its channels queued.
+// -----------------------------------------------------------------------------------
+static void test_drain(void) {
+    for (uint8_t usart = 0; usart < AVR_SIM_USART_COUNT; usart++) {
+        avrSimRunUntilIdle(usart, 100000000ULL);
+    }
+}
+
+// Takes the bytes captured on one USART so far
+static std::string test_raw(uint8_t usart) {
+    std::string raw((const char *)avrSimTxData(usart), avrSimTxCount(usart));
+    avrSimTxClear(usart);
+    return raw;
+}
+
+#if DEBUG_TIMESTAMP || TEST_SHARED_TELEMETRY
+// -----------------------------------------------------------------------------------
+// Record length procedure
+// -----------------------------------------------------------------------------------
+// Input : const std::string &in - De-framed capture
+// Input : size_t i - Offset of a byte in it
+// Output: size_t - Length of the token or telemetry record starting at i, or 0 if the
+//                  byte is text
+// -----------------------------------------------------------------------------------
+static size_t test_record_length(const std::string &in, size_t i) {
+    if (i + 1 >= in.size()) {
+        return 0;
+    }
+    uint8_t c = (uint8_t)in[i];
+    uint8_t next = (uint8_t)in[i + 1];
+    if (c == DEBUG_TOKEN_START) {
+        return 2 + next;
+    }
+    if (c != DEBUG_TELEMETRY_START) {
+        return 0;
+    }
+    if (next == DEBUG_TELEMETRY_BEGIN) {
+        return 3;
+    }
+    if (!(next & DEBUG_TELEMETRY_DELTA)) {
+        return 6;
+    }
+    size_t end = i + 2;
+    while (end < in.size() && ((uint8_t)in[end] & 0x80)) {
+        end++;
+    }
+    return end + 1 - i;
+}
+#endif
+
+// -----------------------------------------------------------------------------------
+// De-framed capture procedure
+// -----------------------------------------------------------------------------------
+// Input : uint8_t usart - USART to read
+// Output: std::string - Bytes sent on the USART since its last capture, de-framed with
+//                       DEBUG_FRAMING, stamps included
+// -----------------------------------------------------------------------------------
+static std::string test_capture_stamped(uint8_t usart) {
+    test_drain();
+    std::string raw = test_raw(usart);
+#if DEBUG_FRAMING
+    std::string out;
+    std::vector<uint8_t> frame;
+    for (size_t i = 0; i < raw.size(); i++) {
+        if (raw[i] != 0) {
+            frame.push_back((uint8_t)raw[i]);
+        } else if (!frame.empty()) {
+            out += test_frame(frame);
+            frame.clear();
+        }
+    }
+    if (!frame.empty()) {
+        printf("FAIL frame: capture ends inside a frame\n");
+        testFailures++;
+    }
+    return out;
+#else
+    return raw;
+#endif
+}
+
+#if DEBUG_TIMESTAMP
+// -----------------------------------------------------------------------------------
+// Stamp removal procedure (DEBUG_TIMESTAMP)
+// -----------------------------------------------------------------------------------
+// Input : const std::string &in - De-framed capture
+// Output: std::string - The capture without its line stamps
+// Timer1 stamps depend on the run, so the cases compare the output without them and
+// test_timestamps checks the stamps themselves. Records are stepped over whole; no case
+// prints text of the decimal "[ticks] " form.
+// -----------------------------------------------------------------------------------
+static std::string test_unstamp(const std::string &in) {
+    std::string out;
+    size_t i = 0;
+    while (i < in.size()) {
+        size_t len = test_record_length(in, i);
+        if (len) {
+            out.append(in, i, len);
+            i += len;
+            continue;
+        }
+#if DEBUG_TIMESTAMP == DEBUG_TIMESTAMP_BINARY
+        if ((uint8_t)in[i] == DEBUG_TIMESTAMP_START) {
+            i += 5;                 // Start byte and the ticks (LE32)
+            continue;
+        }
+#else
+        size_t end = i + 1;
+        while (in[i] == '[' && end < in.size() && isdigit((unsigned char)in[end])) {
+            end++;
+        }
+        if (end > i + 1 && in.compare(end, 2, "] ") == 0) {
+            i = end + 2;
+            continue;
+        }
+#endif
+        out += in[i++];
+    }
+    return out;
+}
+#endif
+
+// Output of one USART, without line stamps
+static std::string test_capture_port(uint8_t usart) {
+#if DEBUG_TIMESTAMP
+    return test_unstamp(test_capture_stamped(usart));
+#else
+    return test_capture_stamped(usart);
+#endif
+}
+
+// Output of the text channel
+static std::string test_capture(void) {
+    return test_capture_port(DEBUG_USART);
+}
+
+// -----------------------------------------------------------------------------------
+// Expectation procedure
+// -----------------------------------------------------------------------------------
+// Input : const char *what - The call under test, for the failure message
+// Input : const std::string &got - Output the call produced
+// Input : const std::string &expected - Output the call must produce
+// Output: void
+// -----------------------------------------------------------------------------------
+static void test_expect(const char *what, const std::string &got, const std::string &expected) {
+    testCount++;
+    if (got == expected) {
+        return;
+    }
+    testFailures++;
+    printf("FAIL %s\n  got      ", what);
+    for (size_t i = 0; i < got.size(); i++) {
+        printf(isprint((unsigned char)got[i]) ? "%c" : "\\x%02X", (unsigned char)got[i]);
+    }
+    printf("\n  expected ");
+    for (size_t i = 0; i < expected.size(); i++) {
+        printf(isprint((unsigned char)expected[i]) ? "%c" : "\\x%02X", (unsigned char)expected[i]);
+    }
+    printf("\n");
+}
+
+#define TEST_EXPECT(call, expected) do { call; test_expect(#call, test_capture(), (expected)); } while (0)
+
+// Counts a case that checks a condition instead of output
+static void test_check(const char *what, bool ok) {
+    testCount++;
+    if (!ok) {
+        printf("FAIL %s\n", what);
+        testFailures++;
+    }
+}
+
+// Token record bytes: start, length, token (LE32), then the encoded arguments
+static std::string test_record(uint32_t token, const char *args, size_t len) {
+    std::string rec;
+    rec += (char)DEBUG_TOKEN_START;
+    rec += (char)(4 + len);
+    for (int i = 0; i < 32; i += 8) {
+        rec += (char)(token >> i);
+    }
+    return rec + std::string(args, len);
+}
+
+// -----------------------------------------------------------------------------------
+// Integer formatting cases
+// -----------------------------------------------------------------------------------
+static void test_integers(void) {
+    TEST_EXPECT(debugPrintInt(0), "0");
+    TEST_EXPECT(debugPrintInt(10), "10");
+    TEST_EXPECT(debugPrintInt(-6789), "-6789");
+    TEST_EXPECT(debugPrintInt(2147483647), "2147483647");
+    TEST_EXPECT(debugPrintInt(INT32_MIN), "-2147483648");
+    TEST_EXPECT(debugPrintIntln(12345), "12345\r\n");
+    TEST_EXPECT(debugPrintUInt(4294967295u), "4294967295");
+    TEST_EXPECT(debugPrintUIntln(0), "0\r\n");
+    TEST_EXPECT(debugPrintUInt64(18446744073709551615ull), "18446744073709551615");
+    TEST_EXPECT(debugPrintUInt64(4294967296ull), "4294967296");
+    TEST_EXPECT(debugPrintUInt64(1000000000007ull), "1000000000007");
+    TEST_EXPECT(debugPrintInt64(INT64_MIN), "-9223372036854775808");
+    TEST_EXPECT(debugPrintInt64(-5), "-5");
+    TEST_EXPECT(debugPrintIntPadded(-42, 6, '0'), "-00042");
+    TEST_EXPECT(debugPrintIntPadded(-42, 6, ' '), "   -42");
+    TEST_EXPECT(debugPrintIntPadded(123456, 3, '0'), "123456");
+    TEST_EXPECT(debugPrintUIntPadded(7, 3, '0'), "007");
+    TEST_EXPECT(debugPrintUInt64Padded(5, 30, '0'), "000000000000000000005");
+    TEST_EXPECT(debugPrintInt64Padded(-5, 4, '0'), "-005");
+    TEST_EXPECT(debugPrintHex8(0xA5), "A5");
+    TEST_EXPECT(debugPrintHex16(0x1F), "001F");
+    TEST_EXPECT(debugPrintHex32(0xDEADBEEF), "DEADBEEF");
+    TEST_EXPECT(debugPrintBin(5, 8), "00000101");
+    TEST_EXPECT(debugPrintBin(0x80000001u, 40), "10000000000000000000000000000001");
+}
+
+// -----------------------------------------------------------------------------------
+// Float and fixed-point formatting cases, including rounding
+// -----------------------------------------------------------------------------------
+static void test_floats(void) {
+    TEST_EXPECT(debugPrintFloat(3.14159f, 2), "3.14");
+    TEST_EXPECT(debugPrintFloat(3.14159f, 3), "3.142");
+    TEST_EXPECT(debugPrintFloat(0.999f, 2), "1.00");
+    TEST_EXPECT(debugPrintFloat(-0.001f, 2), "0.00");
+    TEST_EXPECT(debugPrintFloat(-1.5f, 1), "-1.5");
+    TEST_EXPECT(debugPrintFloat(0.05f, 3), "0.050");
+    TEST_EXPECT(debugPrintFloat(42.718f, 0), "43");
+    TEST_EXPECT(debugPrintFloat(20000.123f, 3), "20000.123");     // Digits the float holds
+    TEST_EXPECT(debugPrintFloat(16777.217f, 3), "16777.217");
+    TEST_EXPECT(debugPrintFloat(123456.78f, 3), "123456.781");
+    TEST_EXPECT(debugPrintFloat(-2.5f, 0), "-3");
+    TEST_EXPECT(debugPrintFloat(9.9996f, 3), "10.000");            // Carry into the integer part
+    TEST_EXPECT(debugPrintFloat(4294967040.0f, 1), "4294967040.0");
+    TEST_EXPECT(debugPrintFloat(1e12f, 2), "999999995904.00");     // Exact value of the float
+    TEST_EXPECT(debugPrintFloat(1e12f, 3), "999999995904.000");
+    TEST_EXPECT(debugPrintFloat(1e30f, 2), "ovf");
+    TEST_EXPECT(debugPrintFloat(NAN, 2), "nan");
+    TEST_EXPECT(debugPrintFloat(-INFINITY, 2), "-inf");
+    TEST_EXPECT(debugPrintFloatln(2.5f, 1), "2.5\r\n");
+    TEST_EXPECT(debugPrintQ15(0x4000, 2), "0.50");
+    TEST_EXPECT(debugPrintQ15(-32768, 4), "-1.0000");
+    TEST_EXPECT(debugPrintQ15(32767, 4), "1.0000");
+    TEST_EXPECT(debugPrintQ15(32767, 5), "0.99997");
+    TEST_EXPECT(debugPrintQ16(205887, 5), "3.14159");
+    TEST_EXPECT(debugPrintQ16(-205887, 2), "-3.14");
+    TEST_EXPECT(debugPrintQ7(-128, 0), "-1");
+    TEST_EXPECT(debugPrintFixed(INT32_MIN, 0, 2), "-2147483648.00");
+    TEST_EXPECT(debugPrintFixed(2147483647, 31, 9), "1.000000000");
+    TEST_EXPECT(debugPrintFixed(3, 1, 0), "2");
+}
+
+// -----------------------------------------------------------------------------------
+// String, debugLog and overflow cases
+// -----------------------------------------------------------------------------------
+static void test_text(void) {
+    TEST_EXPECT(debugPrintln("hello"), "hello\r\n");
+    TEST_EXPECT(debugPrintln_P(DEBUG_STR("flash text")), "flash text\r\n");
+    TEST_EXPECT(debugLog("temp=", 21.5f, " rpm=", 1500, " id=", (uint8_t)7, ' ', (int8_t)-3, DEBUG_F(" ok")),
+                "temp=21.50 rpm=1500 id=7 -3 ok\r\n");
+    TEST_EXPECT(debugLog("ts=", 1752000000000000ULL, " n=", INT64_MIN, " b=", true),
+                "ts=1752000000000000 n=-9223372036854775808 b=1\r\n");
+    TEST_EXPECT(debugLog("f=", debugLogFloat(3.14159f, 4), " h=", debugLogHex(0xBEEF, 4)), "f=3.1416 h=BEEF\r\n");
+    TEST_EXPECT(debugLog(), "\r\n");
+
+    // A line longer than DEBUG_LOG_LINE_SIZE is cut, keeping its line end
+    std::string line(DEBUG_LOG_LINE_SIZE + 20, 'a');
+    TEST_EXPECT(debugLog(line.c_str(), 5), std::string(DEBUG_LOG_LINE_SIZE - 2, 'a') + "\r\n");
+
+    // Writes that fit are never cut, however many follow each other
+    for (int i = 0; i < 50; i++) {
+        TEST_EXPECT(debugPrint("abcdefghijklmnopq"), "abcdefghijklmnopq");
+    }
+#if !DEBUG_FRAMING && (DEBUG_OVERFLOW_POLICY == DEBUG_OVERFLOW_DROP_NEWEST)
+    // DROP_NEWEST keeps what fits: the ring buffer, plus the bytes the transmitter took
+    std::string big(300, 'x');
+    TEST_EXPECT(debugPrint(big.c_str()), big.substr(0, DEBUG_BUFFER_SIZE + 1));
+#endif
+#if DEBUG_OVERFLOW_POLICY == DEBUG_OVERFLOW_BLOCK
+    std::string big(300, 'x');
+    TEST_EXPECT(debugPrint(big.c_str()), big);
+#endif
+}
+
+// -----------------------------------------------------------------------------------
+// Token record cases
+// -----------------------------------------------------------------------------------
+// Zigzag varints for signed values, plain varints for unsigned ones, floats as four
+// little-endian bytes and strings as a length byte and the characters.
+// -----------------------------------------------------------------------------------
+static void test_tokens(void) {
+    TEST_EXPECT(DEBUG_TOKEN_LOG("temp=%d rpm=%u", -40, 3000u),
+                test_record(debugTokenHash("temp=%d rpm=%u"), "\x4F\xB8\x17", 3));
+    TEST_EXPECT(DEBUG_TOKEN_LOG("min=%d %lld", INT32_MIN, INT64_MIN),
+                test_record(debugTokenHash("min=%d %lld"),
+                            "\xFF\xFF\xFF\xFF\x0F" "\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\x01", 15));
+    TEST_EXPECT(DEBUG_TOKEN_LOG("v=%.2f %s", 21.5f, "ok"),
+                test_record(debugTokenHash("v=%.2f %s"), "\x00\x00\xAC\x41\x02ok", 7));
+    TEST_EXPECT(DEBUG_TOKEN_LOG("no args"), test_record(debugTokenHash("no args"), "", 0));
+}
+
+#if DEBUG_TIMESTAMP && defined(DEBUG_TIMESTAMP_SOURCE)
+// Stamp the library puts ahead of a line written at ticks
+static std::string test_stamp(uint32_t ticks) {
+#if DEBUG_TIMESTAMP == DEBUG_TIMESTAMP_BINARY
+    std::string stamp(1, (char)DEBUG_TIMESTAMP_START);
+    for (int i = 0; i < 32; i += 8) {
+        stamp += (char)(ticks >> i);
+    }
+    return stamp;
+#else
+    char stamp[16];
+    snprintf(stamp, sizeof(stamp), "[%lu] ", (unsigned long)ticks);
+    return stamp;
+#endif
+}
+
+// -----------------------------------------------------------------------------------
+// Line stamp cases (DEBUG_TIMESTAMP_SOURCE)
+// -----------------------------------------------------------------------------------
+// A line carries the stamp taken when its first byte was written, however many writes
+// make it up; every token record and every debugEventService line carries its own.
+// Runs while the text channel is at a line start.
+// -----------------------------------------------------------------------------------
+static void test_timestamps(void) {
+    testTicks = 1000;
+    debugPrint("ab");
+    testTicks = 1001;
+    debugPrintln("c");
+    debugPrintln("d");
+    test_expect("stamped lines", test_capture_stamped(DEBUG_USART),
+                test_stamp(1000) + "abc\r\n" + test_stamp(1001) + "d\r\n");
+
+    testTicks = 0x12345678;
+    DEBUG_TOKEN_LOG("no args");
+    test_expect("stamped token record", test_capture_stamped(DEBUG_USART),
+                test_stamp(0x12345678) + test_record(debugTokenHash("no args"), "", 0));
+
+#if DEBUG_EVENT_QUEUE_SIZE > 0
+    testTicks = 2000;
+    debugEvent(1, 100);
+    debugEvent(2, 65535);
+    debugEventService();
+    test_expect("stamped events", test_capture_stamped(DEBUG_USART),
+                test_stamp(2000) + "evt 1: 100\r\n" + test_stamp(2000) + "evt 2: 65535\r\n");
+
+    testTicks = 3000;
+    debugEvent(3, 0);
+    for (int i = 0; i < DEBUG_EVENT_QUEUE_SIZE; i++) {
+        debugEvent(4, 0);           // The queue holds DEBUG_EVENT_QUEUE_SIZE - 1
+    }
+    std::string expected = test_stamp(3000) + "evt 3: 0\r\n";
+    for (int i = 0; i < DEBUG_EVENT_QUEUE_SIZE - 2; i++) {
+        expected += test_stamp(3000) + "evt 4: 0\r\n";
+    }
+    debugEventService();
+    test_expect("stamped dropped events", test_capture_stamped(DEBUG_USART),
+                expected + test_stamp(3000) + "[2 events dropped]\r\n");
+#endif
+}
+#endif
+
+#if DEBUG_EVENT_QUEUE_SIZE > 0
+// Services the event queue until it and the drop report are out, draining in between
+static void test_service_events(void) {
+    while (debugEventService() > 0) {
+        test_drain();
+    }
+}
+
+// -----------------------------------------------------------------------------------
+// Event queue cases (DEBUG_EVENT_QUEUE_SIZE)
+// -----------------------------------------------------------------------------------
+// Queued events come out oldest first as "evt <id>: <arg>" lines, events lost to a
+// full queue are reported once, and an event stays queued while the text buffer has no
+// room for its line.
+// -----------------------------------------------------------------------------------
+static void test_events(void) {
+    uint8_t count = 0xFF;
+    debugEvent(5, 65535);
+    TEST_EXPECT(count = debugEventService(), "evt 5: 65535\r\n");
+    test_check("debugEventService count", count == 1);
+    TEST_EXPECT(count = debugEventService(), "");
+    test_check("debugEventService on an empty queue", count == 0);
+
+    std::string expected;
+    for (int i = 0; i <= DEBUG_EVENT_QUEUE_SIZE; i++) {
+        debugEvent(7, (uint16_t)i);     // The queue holds DEBUG_EVENT_QUEUE_SIZE - 1
+        if (i < DEBUG_EVENT_QUEUE_SIZE - 1) {
+            expected += "evt 7: " + std::to_string(i) + "\r\n";
+        }
+    }
+    TEST_EXPECT(test_service_events(), expected + "[2 events dropped]\r\n");
+    TEST_EXPECT(debugEventService(), "");       // Reported once
+
+#if DEBUG_OVERFLOW_POLICY != DEBUG_OVERFLOW_BLOCK
+    // The fill continues a line, so no stamp takes room from it
+    std::string fill(DEBUG_BUFFER_SIZE - 1 - (DEBUG_FRAMING ? DEBUG_FRAME_OVERHEAD : 0), 'x');
+    TEST_EXPECT(debugPrint("events "), "events ");
+    cli();
+    debugWrite(fill.c_str(), (uint8_t)fill.size());
+    debugEvent(8, 1);
+    count = debugEventService();
+    sei();
+    test_expect("event held back by a full buffer", test_capture(), fill);
+    test_check("held back event count", count == 0);
+    TEST_EXPECT(debugEventService(), "evt 8: 1\r\n");
+#endif
+}
+#endif
+
+// -----------------------------------------------------------------------------------
+// Flush cases
+// -----------------------------------------------------------------------------------
+// debugFlush returns once the last byte has left the TX pin, with no help from the
+// test; debugFlushTimeout gives up while bytes are still on their way.
+// -----------------------------------------------------------------------------------
+static void test_flush(void) {
+    test_check("debugFlushTimeout(0) when idle", debugFlushTimeout(0));
+    debugPrintln("flush me");
+    test_check("debugFlushTimeout(0) while sending", !debugFlushTimeout(0));
+    test_check("debugFlushTimeout too short", !debugFlushTimeout(DEBUG_FLUSH_POLL_CYCLES));
+    debugFlush();
+    size_t sent = avrSimTxCount(DEBUG_USART);
+    test_check("debugFlush empties the buffers", debugPending() == 0 && debugFlushTimeout(0));
+    test_drain();
+    test_check("debugFlush waits for the last byte", avrSimTxCount(DEBUG_USART) == sent);
+    test_expect("debugFlush output", test_capture(), "flush me\r\n");
+
+    debugPrintln("flush me too");
+    test_check("debugFlushTimeout long enough", debugFlushTimeout(F_CPU / 10));
+    test_expect("debugFlushTimeout output", test_capture(), "flush me too\r\n");
+}
+
+// -----------------------------------------------------------------------------------
+// Panic mode cases
+// -----------------------------------------------------------------------------------
+// With interrupts disabled for good, debugPanicBegin still sends what was queued, then
+// the queued events, and every later call returns with its output handed to the USART.
+// The capture runs the emulator with interrupts disabled, so a byte left for the UDRE
+// interrupt would be missing. Panic mode lasts until the next debugSerialBegin, so
+// these cases run last.
+// -----------------------------------------------------------------------------------
+static void test_panic(void) {
+    std::string expected = "queued\r\n";
+    cli();
+    debugPrintln("queued");
+#if DEBUG_EVENT_QUEUE_SIZE > 0
+    debugEvent(9, 99);
+    expected += "evt 9: 99\r\n";
+#endif
+    debugPanicBegin();
+    debugPrintln("panic");
+    test_check("panic mode leaves nothing queued", debugPending() == 0);
+    test_expect("panic mode", test_capture(), expected + "panic\r\n");
+    sei();
+}
+
+#if DEBUG_STATS
+// -----------------------------------------------------------------------------------
+// Statistics cases
+// -----------------------------------------------------------------------------------
+static void test_stats(void) {
+    debugStats_t stats;
+    TEST_EXPECT(debugPrint("stats "), "stats ");     // Mid-line: no stamp is counted
+    debugStatsReset();
+    TEST_EXPECT(debugPrint("0123456789"), "0123456789");
+    debugStatsGet(DEBUG_CHANNEL_TEXT, &stats);
+    testCount++;
+    if (stats.enqueued != 10 + (DEBUG_FRAMING ? DEBUG_FRAME_OVERHEAD : 0) || stats.dropped != 0) {
+        printf("FAIL stats: enqueued %lu, dropped %lu\n", (unsigned long)stats.enqueued,
+               (unsigned long)stats.dropped);
+        testFailures++;
+    }
+}
+#endif
+
+#if TEST_SHARED_TELEMETRY
+// Text and telemetry records of a capture, told apart the way the host tools do it
+typedef struct {
+    std::string text;
+    unsigned records;               // Telemetry records
+    unsigned recordsBeforeText;     // Telemetry records ahead of the first text byte
+} testStream_t;
+
+// -----------------------------------------------------------------------------------
+// Capture split procedure
+// -----------------------------------------------------------------------------------
+// Input : const std::string &in - De-framed capture
+// Output: testStream_t - Its text, with token records left out, and its telemetry
+//                        record count
+// -----------------------------------------------------------------------------------
+static testStream_t test_split(const std::string &in) {
+    testStream_t out;
+    out.records = 0;
+    out.recordsBeforeText = 0;
+    for (size_t i = 0; i < in.size(); i++) {
+        uint8_t c = (uint8_t)in[i];
+        size_t len = test_record_length(in, i);
+        if (len) {
+            out.records += (c == DEBUG_TELEMETRY_START);
+            i += len - 1;
+        } else {
+            if (out.text.empty()) {
+                out.recordsBeforeText = out.records;
+            }
+            out.text += (char)c;
+        }
+    }
+    return out;
+}
+#endif
+
+// Prints a line to the fault channel (the text channel if the build has none)
+static void test_fault(const char *text) {
+    uint8_t previous = debugChannelSelect(DEBUG_CHANNEL_FAULT);
+    debugPrintln(text);
+    debugChannelSelect(previous);
+}
+
+// -----------------------------------------------------------------------------------
+// Channel scheduling cases
+// -----------------------------------------------------------------------------------
+// Each channel's output must leave on its own USART. Where channels share a USART,
+// queued messages go out in priority order fault, text, telemetry, a message on the
+// wire is finished before another channel takes over, and each channel keeps its own
+// buffer. Interrupts are masked while a case queues its output, so the UDRE interrupt
+// sees all of it at once.
+// -----------------------------------------------------------------------------------
+static void test_channels(void) {
+    test_fault("fault");
+    test_expect("fault channel USART", test_capture_port(TEST_FAULT_USART), "fault\r\n");
+    debugTelemetryBegin(1);
+    test_expect("telemetry channel USART", test_capture_port(TEST_TELEMETRY_USART),
+                std::string("\x1D\x7F\x01", 3));
+
+#if (DEBUG_FAULT_BUFFER_SIZE > 0) && (TEST_FAULT_USART == DEBUG_USART)
+    cli();
+    debugPrintln("text");
+    test_fault("fault");
+    sei();
+    test_expect("fault ahead of text", test_capture(), "fault\r\ntext\r\n");
+
+    // The text line on the wire keeps the USART up to its line end; framed, every write
+    // is a message of its own and the fault line follows the frame, which is the line
+    // stamp's frame with DEBUG_TIMESTAMP
+    cli();
+    debugPrint("0123456789");
+    sei();
+    cli();
+    test_fault("F");
+    debugPrintln(" end");
+    sei();
+    test_expect("owner finishes its message", test_capture(),
+                !DEBUG_FRAMING ? "0123456789 end\r\nF\r\n" :
+                DEBUG_TIMESTAMP ? "F\r\n0123456789 end\r\n" : "0123456789F\r\n end\r\n");
+
+    // A full text buffer leaves the fault buffer free. The fill continues a line, so no
+    // stamp takes room from it
+    std::string fill(DEBUG_BUFFER_SIZE - 1 - (DEBUG_FRAMING ? DEBUG_FRAME_OVERHEAD : 0), 'x');
+    TEST_EXPECT(debugPrint("fill "), "fill ");
+    cli();
+    debugWrite(fill.c_str(), (uint8_t)fill.size());
+    test_fault("fault");
+    sei();
+    test_expect("separate buffers", test_capture(), "fault\r\n" + fill);
+
+#if (DEBUG_OVERFLOW_POLICY == DEBUG_OVERFLOW_DROP_OLDEST) && !DEBUG_FRAMING
+    // Discarding the rest of the line on the wire ends its message: the fault line goes
+    // next, not after the newer text that took the room
+    std::string line(DEBUG_BUFFER_SIZE / 2, 'a');
+    cli();
+    debugWrite(line.c_str(), (uint8_t)line.size());
+    sei();
+    avrSimRun(100);                                 // The ISR takes the first byte
+    cli();
+    test_fault("F");
+    debugWrite(fill.c_str(), (uint8_t)fill.size());
+    sei();
+    std::string got = test_capture();
+    test_expect("discard releases the USART", got.substr(got.find_first_not_of('a')),
+                "F\r\n" + fill);
+#endif
+#endif
+
+#if (DEBUG_TELEMETRY_BUFFER_SIZE > 0) && (TEST_TELEMETRY_USART == DEBUG_USART)
+    cli();
+    debugTelemetryBegin(1);
+    debugPrintln("text");
+    sei();
+    test_expect("text ahead of telemetry", test_capture(), std::string("text\r\n\x1D\x7F\x01", 9));
+#endif
+
+#if TEST_SHARED_TELEMETRY
+    // Telemetry kept streaming, its buffer never running empty: the fault line must get
+    // in between two records instead of waiting behind all of them
+    debugTelemetryBegin(1);
+    unsigned queued = 1;
+    unsigned queuedAtFault = 0;
+    for (int32_t i = 0; i < 120; ) {
+        if (debugPending() >= DEBUG_TELEMETRY_BUFFER_SIZE / 2) {
+            avrSimRun(200);
+            continue;
+        }
+        debugTelemetrySample(0, i++);
+        queued++;
+        if (i == 40) {
+            test_fault("FAULT");
+            queuedAtFault = queued;
+        }
+    }
+    testStream_t stream = test_split(test_capture_port(TEST_FAULT_USART));
+    test_expect("fault during telemetry", stream.text, "FAULT\r\n");
+    testCount++;
+    if (stream.records != queued || stream.recordsBeforeText > queuedAtFault) {
+        printf("FAIL fault during telemetry: %u of %u records, %u ahead of the fault line "
+               "(at most %u)\n", stream.records, queued, stream.recordsBeforeText, queuedAtFault);
+        testFailures++;
+    }
+#endif
+}
+
+// -----------------------------------------------------------------------------------
+// Round trip capture procedure
+// -----------------------------------------------------------------------------------
+// Input : const char *path - File that receives the raw TX bytes
+// Output: bool - Returns false if the file cannot be written
+// The CMake round trip tests decode this file with debugDecode, which reads the format
+// strings back from this executable and must skip the telemetry records, and with
+// debugDeframe. The library is started again first so the capture begins like one
+// taken from reset, with DEBUG_FRAMING at the leading delimiter.
+// -----------------------------------------------------------------------------------
+static bool test_write_capture(const char *path) {
+    avrSimReset();
+    debugSerialBegin(115200);
+    debugLog("hello ", 42);
+    test_drain();                               // Each write gets the whole buffer
+    debugTelemetryBegin(2);
+    test_drain();
+    debugTelemetrySample(0, 0x1E0A1D0A);      // Record bytes that look like text and markers
+    test_drain();
+    debugTelemetrySample(1, -10);
+    test_drain();
+    DEBUG_TOKEN_LOG("temp=%d rpm=%u", -40, 3000u);
+    test_drain();
+    DEBUG_TOKEN_LOG("min=%d %lld", INT32_MIN, INT64_MIN);
+    test_drain();
+    DEBUG_TOKEN_LOG("v=%.2f %s", 21.5f, "ok");
+    test_drain();
+    DEBUG_TOKEN_LOG("no args");
+    test_drain();
+
+    std::string raw = test_raw(DEBUG_USART);
+    if (TEST_TELEMETRY_USART != DEBUG_USART) {
+        raw += test_raw(TEST_TELEMETRY_USART);      // Its own stream, appended
+    }
+    FILE *out = fopen(path, "wb");
+    if (!out) {
+        perror(path);
+        return false;
+    }
+    fwrite(raw.data(), 1, raw.size(), out);
+    return fclose(out) == 0;
+}
+
+int main(int argc, char **argv) {
+    avrSimReset();
+    debugSerialBegin(115200);
+
+#if DEBUG_TIMESTAMP && defined(DEBUG_TIMESTAMP_SOURCE)
+    test_timestamps();
+#endif
+    test_integers();
+    test_floats();
+    test_text();
+    test_tokens();
+    test_channels();
+#if DEBUG_EVENT_QUEUE_SIZE > 0
+    test_events();
+#endif
+    test_flush();
+#if DEBUG_STATS
+    test_stats();
+#endif
+    test_panic();
+    if (argc > 1 && !test_write_capture(argv[1])) {
+        testFailures++;
+    }
+
+    printf("%u cases, %u failed\n", testCount, testFailures);
+    return testFailures ? 1 : 0;
+}
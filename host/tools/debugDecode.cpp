@@ -0,0 +1,351 @@
+/*
+ * debugDecode.cpp
+ *
+ * Host decoder for the debugSerial tokenized logging records (DEBUG_TOKEN_LOG).
+ *
+ * Usage: debugDecode firmware.elf [capture]
+ *        debugDecode --list firmware.elf
+ *
+ * Reads the format strings from the DEBUG_TOKEN_SECTION of the firmware ELF file (32- or
+ * 64-bit, little-endian; use the .elf, not the .hex), hashes each one with the same
+ * FNV-1a function the target uses, then reads the captured TX stream from the capture
+ * file or stdin. Plain text is copied through unchanged; every token record is printed
+ * as one line of text, and DEBUG_TIMESTAMP_BINARY stamps as "[ticks] ". Telemetry
+ * records (debugTelemetry*) are skipped; convert them with debugTelemetry. For a live
+ * port: stty -F /dev/ttyUSB0 raw 115200 first, then
+ * debugDecode firmware.elf /dev/ttyUSB0.
+ */
+
+#include "debugSerial.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+typedef std::map<uint32_t, std::string> decodeTable_t;
+
+// -----------------------------------------------------------------------------------
+// Format string hash procedure
+// -----------------------------------------------------------------------------------
+// Input : const std::string &s - Format string as stored in the ELF section
+// Output: uint32_t - 32-bit FNV-1a hash, identical to debugTokenHash on the target
+// -----------------------------------------------------------------------------------
+static uint32_t decode_hash(const std::string &s) {
+    uint32_t h = 2166136261UL;
+    for (size_t i = 0; i < s.size(); i++) {
+        h = (h ^ (uint8_t)s[i]) * 16777619UL;
+    }
+    return h;
+}
+
+// -----------------------------------------------------------------------------------
+// Little-endian field read procedure
+// -----------------------------------------------------------------------------------
+// Input : const std::vector<uint8_t> &img - File contents
+// Input : size_t off - Offset of the field
+// Input : size_t size - Field width in bytes (at most 8)
+// Output: uint64_t - Field value, or 0 if it lies outside the file
+// -----------------------------------------------------------------------------------
+static uint64_t decode_field(const std::vector<uint8_t> &img, size_t off, size_t size) {
+    uint64_t value = 0;
+    if (off + size > img.size()) {
+        return 0;
+    }
+    for (size_t i = size; i > 0; i--) {
+        value = (value << 8) | img[off + i - 1];
+    }
+    return value;
+}
+
+// -----------------------------------------------------------------------------------
+// Token table load procedure
+// -----------------------------------------------------------------------------------
+// Input : const char *path - Firmware ELF file
+// Input : decodeTable_t &table - Receives token -> format string
+// Output: bool - Returns false if the file is unreadable or has no token section
+// Walks the section headers for DEBUG_TOKEN_SECTION and splits it at the NUL bytes
+// (the assembler may pad it with extra NULs). A call site that was inlined several
+// times leaves duplicate strings, which hash to the same token and are harmless.
+// -----------------------------------------------------------------------------------
+static bool decode_load_table(const char *path, decodeTable_t &table) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        perror(path);
+        return false;
+    }
+    std::vector<uint8_t> img;
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        img.insert(img.end(), chunk, chunk + n);
+    }
+    fclose(f);
+
+    if (img.size() < 52 || memcmp(img.data(), "\x7f" "ELF", 4) != 0 || img[5] != 1) {
+        fprintf(stderr, "%s: not a little-endian ELF file\n", path);
+        return false;
+    }
+    bool is64 = (img[4] == 2);
+    size_t shoff = decode_field(img, is64 ? 0x28 : 0x20, is64 ? 8 : 4);
+    size_t shentsize = decode_field(img, is64 ? 0x3A : 0x2E, 2);
+    size_t shnum = decode_field(img, is64 ? 0x3C : 0x30, 2);
+    size_t shstrndx = decode_field(img, is64 ? 0x3E : 0x32, 2);
+    size_t offField = is64 ? 0x18 : 0x10;
+    size_t sizeField = is64 ? 0x20 : 0x14;
+    size_t addrSize = is64 ? 8 : 4;
+
+    size_t strtab = decode_field(img, shoff + shstrndx * shentsize + offField, addrSize);
+    for (size_t i = 0; i < shnum; i++) {
+        size_t sh = shoff + i * shentsize;
+        size_t name = strtab + decode_field(img, sh, 4);
+        if (name + sizeof(DEBUG_TOKEN_SECTION) > img.size() ||
+            memcmp(&img[name], DEBUG_TOKEN_SECTION, sizeof(DEBUG_TOKEN_SECTION)) != 0) {
+            continue;
+        }
+        size_t off = decode_field(img, sh + offField, addrSize);
+        size_t size = decode_field(img, sh + sizeField, addrSize);
+        if (off + size > img.size()) {
+            break;
+        }
+        size_t start = off;
+        for (size_t p = off; p < off + size; p++) {
+            if (img[p] != 0) {
+                continue;
+            }
+            if (p > start) {
+                std::string fmt((const char *)&img[start], p - start);
+                uint32_t token = decode_hash(fmt);
+                decodeTable_t::iterator it = table.find(token);
+                if (it != table.end() && it->second != fmt) {
+                    fprintf(stderr, "warning: token %08X collides: \"%s\" / \"%s\"\n",
+                            token, it->second.c_str(), fmt.c_str());
+                }
+                table[token] = fmt;
+            }
+            start = p + 1;
+        }
+        return true;
+    }
+    fprintf(stderr, "%s: no %s section (no DEBUG_TOKEN_LOG call sites?)\n", path, DEBUG_TOKEN_SECTION);
+    return false;
+}
+
+// -----------------------------------------------------------------------------------
+// Varint read procedure
+// -----------------------------------------------------------------------------------
+// Input : const uint8_t *&p - Read position, advanced past the varint
+// Input : const uint8_t *end - End of the payload
+// Input : uint64_t &value - Decoded value
+// Output: bool - Returns false if the payload ends inside the varint
+// -----------------------------------------------------------------------------------
+static bool decode_varint(const uint8_t *&p, const uint8_t *end, uint64_t &value) {
+    value = 0;
+    for (uint8_t shift = 0; p < end && shift < 64; shift += 7) {
+        uint8_t b = *p++;
+        value |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// -----------------------------------------------------------------------------------
+// Record formatting procedure
+// -----------------------------------------------------------------------------------
+// Input : const std::string &fmt - Format string of the record's token
+// Input : const uint8_t *p - First encoded argument
+// Input : const uint8_t *end - End of the payload
+// Output: std::string - The reconstructed text
+// Walks the printf-style format, taking one argument per conversion. Length modifiers
+// are ignored: the encoding already carries full-width integers. Arguments missing
+// from a short payload print as "<?>".
+// -----------------------------------------------------------------------------------
+static std::string decode_format(const std::string &fmt, const uint8_t *p, const uint8_t *end) {
+    std::string out;
+    char piece[512];
+    for (size_t i = 0; i < fmt.size(); i++) {
+        if (fmt[i] != '%') {
+            out += fmt[i];
+            continue;
+        }
+        std::string spec = "%";
+        size_t j = i + 1;
+        while (j < fmt.size() && strchr("-+ #0123456789.", fmt[j])) {
+            spec += fmt[j++];
+        }
+        while (j < fmt.size() && strchr("hlLqjzt", fmt[j])) {
+            j++;
+        }
+        if (j >= fmt.size()) {
+            out += fmt.substr(i);
+            break;
+        }
+        char conv = fmt[j];
+        i = j;
+        uint64_t raw;
+        bool ok = true;
+        switch (conv) {
+        case '%':
+            out += '%';
+            continue;
+        case 'd': case 'i':
+            ok = decode_varint(p, end, raw);
+            snprintf(piece, sizeof(piece), (spec + "lld").c_str(),
+                     (long long)((raw >> 1) ^ (0 - (raw & 1))));
+            break;
+        case 'u': case 'x': case 'X': case 'o':
+            ok = decode_varint(p, end, raw);
+            snprintf(piece, sizeof(piece), (spec + "ll" + conv).c_str(), (unsigned long long)raw);
+            break;
+        case 'c':
+            ok = decode_varint(p, end, raw);
+            snprintf(piece, sizeof(piece), (spec + "c").c_str(), (int)raw);
+            break;
+        case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': {
+            float value = 0;
+            ok = (end - p >= (long)sizeof(float));
+            if (ok) {
+                memcpy(&value, p, sizeof(float));
+                p += sizeof(float);
+            }
+            snprintf(piece, sizeof(piece), (spec + conv).c_str(), (double)value);
+            break;
+        }
+        case 's': {
+            uint8_t len = (p < end) ? *p++ : 0;
+            ok = (end - p >= len);
+            std::string str = ok ? std::string((const char *)p, len) : std::string();
+            p += ok ? len : 0;
+            snprintf(piece, sizeof(piece), (spec + "s").c_str(), str.c_str());
+            break;
+        }
+        default:
+            out += spec;
+            out += conv;
+            continue;
+        }
+        out += ok ? piece : "<?>";
+    }
+    return out;
+}
+
+// -----------------------------------------------------------------------------------
+// Telemetry record skip procedure
+// -----------------------------------------------------------------------------------
+// Input : FILE *in - Captured TX stream, positioned after DEBUG_TELEMETRY_START
+// Output: bool - Returns false if the stream ends inside the record
+// Reads past the channel byte and its value: one count byte after DEBUG_TELEMETRY_BEGIN,
+// a zig-zag varint for a DEBUG_TELEMETRY_DELTA sample, four bytes otherwise. The value
+// bytes may hold 0x1C to 0x1E or '\n', so they must not be taken for text.
+// -----------------------------------------------------------------------------------
+static bool decode_skip_telemetry(FILE *in) {
+    int id = fgetc(in);
+    if (id == EOF) {
+        return false;
+    }
+    if (id == DEBUG_TELEMETRY_BEGIN) {
+        return fgetc(in) != EOF;
+    }
+    if (id & DEBUG_TELEMETRY_DELTA) {
+        int b;
+        do {
+            b = fgetc(in);
+        } while (b != EOF && (b & 0x80));
+        return b != EOF;
+    }
+    for (uint8_t i = 0; i < 4; i++) {
+        if (fgetc(in) == EOF) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// Stream decode procedure
+// -----------------------------------------------------------------------------------
+// Input : FILE *in - Captured TX stream
+// Input : const decodeTable_t &table - Token -> format string
+// Output: void
+// Copies text through, replaces each DEBUG_TOKEN_START record with its line and each
+// binary DEBUG_TIMESTAMP_START stamp with "[ticks] ", and drops telemetry records.
+// -----------------------------------------------------------------------------------
+static void decode_stream(FILE *in, const decodeTable_t &table) {
+    int c;
+    while ((c = fgetc(in)) != EOF) {
+        if (c == DEBUG_TIMESTAMP_START) {
+            uint8_t stamp[4];
+            if (fread(stamp, 1, sizeof(stamp), in) < sizeof(stamp)) {
+                break;
+            }
+            printf("[%lu] ", (unsigned long)stamp[0] | ((unsigned long)stamp[1] << 8) |
+                             ((unsigned long)stamp[2] << 16) | ((unsigned long)stamp[3] << 24));
+            continue;
+        }
+        if (c == DEBUG_TELEMETRY_START) {
+            if (!decode_skip_telemetry(in)) {
+                break;
+            }
+            continue;
+        }
+        if (c != DEBUG_TOKEN_START) {
+            putchar(c);
+            continue;
+        }
+        int len = fgetc(in);
+        if (len == EOF) {
+            break;
+        }
+        uint8_t payload[256];
+        size_t got = fread(payload, 1, (size_t)len, in);
+        if (got < 4 || got < (size_t)len) {
+            printf("<truncated record>\n");
+            continue;
+        }
+        uint32_t token = (uint32_t)payload[0] | ((uint32_t)payload[1] << 8) |
+                         ((uint32_t)payload[2] << 16) | ((uint32_t)payload[3] << 24);
+        decodeTable_t::const_iterator it = table.find(token);
+        if (it == table.end()) {
+            printf("<unknown token %08X>\n", token);
+        } else {
+            printf("%s\n", decode_format(it->second, payload + 4, payload + got).c_str());
+        }
+        fflush(stdout);
+    }
+}
+
+int main(int argc, char **argv) {
+    bool list = (argc > 1 && strcmp(argv[1], "--list") == 0);
+    int first = list ? 2 : 1;
+    if (argc <= first) {
+        fprintf(stderr, "usage: %s firmware.elf [capture]\n"
+                        "       %s --list firmware.elf\n", argv[0], argv[0]);
+        return 2;
+    }
+
+    decodeTable_t table;
+    if (!decode_load_table(argv[first], table)) {
+        return 1;
+    }
+    if (list) {
+        for (decodeTable_t::const_iterator it = table.begin(); it != table.end(); ++it) {
+            printf("%08X %s\n", it->first, it->second.c_str());
+        }
+        return 0;
+    }
+
+    FILE *in = stdin;
+    if (argc > first + 1) {
+        in = fopen(argv[first + 1], "rb");
+        if (!in) {
+            perror(argv[first + 1]);
+            return 1;
+        }
+    }
+    decode_stream(in, table);
+    return 0;
+}
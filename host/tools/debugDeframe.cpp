@@ -0,0 +1,131 @@
+/*
+ * debugDeframe.cpp
+ *
+ * Host de-framer for debugSerial built with DEBUG_FRAMING=1.
+ *
+ * Usage: debugDeframe [capture]
+ *
+ * Reads the captured TX stream from the capture file or stdin, splits it at the 0x00
+ * delimiters, COBS-decodes each frame and checks its CRC-16. The data of every good
+ * frame is written to stdout, so the output can be read directly or piped into
+ * debugDecode for tokenized records. At the end a summary goes to stderr: frames
+ * received, corrupt frames (bad COBS or CRC), frames missing from the sequence
+ * numbers (dropped on the target, or corrupt), and the resulting loss rate. Each
+ * channel sharing the USART is counted on its own; a gap of 64 frames or more wraps
+ * its 6-bit sequence counter and is under-counted.
+ */
+
+#include "debugSerial.h"
+
+#include <util/crc16.h>
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+typedef struct {
+    unsigned long good;
+    unsigned long corrupt;
+    unsigned long missing;
+    bool synced[1 << (8 - DEBUG_FRAME_SEQ_BITS)];      // Per channel
+    uint8_t nextSeq[1 << (8 - DEBUG_FRAME_SEQ_BITS)];
+} deframeStats_t;
+
+// -----------------------------------------------------------------------------------
+// COBS decode procedure
+// -----------------------------------------------------------------------------------
+// Input : const std::vector<uint8_t> &in - One encoded frame, without the delimiter
+// Input : std::vector<uint8_t> &out - Receives the decoded bytes
+// Output: bool - Returns false if a code byte points past the end of the frame
+// -----------------------------------------------------------------------------------
+static bool deframe_cobs(const std::vector<uint8_t> &in, std::vector<uint8_t> &out) {
+    out.clear();
+    size_t i = 0;
+    while (i < in.size()) {
+        uint8_t code = in[i++];
+        if (code == 0 || i + code - 1 > in.size()) {
+            return false;
+        }
+        out.insert(out.end(), in.begin() + i, in.begin() + i + code - 1);
+        i += code - 1;
+        if (code != 0xFF && i < in.size()) {
+            out.push_back(0);
+        }
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------------
+// Frame check procedure
+// -----------------------------------------------------------------------------------
+// Input : const std::vector<uint8_t> &frame - One encoded frame, without the delimiter
+// Input : deframeStats_t *stats - Running counters
+// Output: void
+// Verifies the CRC over sequence number and data, counts the sequence gap since the
+// previous good frame of the same channel and writes the data to stdout.
+// -----------------------------------------------------------------------------------
+static void deframe_frame(const std::vector<uint8_t> &frame, deframeStats_t *stats) {
+    std::vector<uint8_t> data;
+    if (!deframe_cobs(frame, data) || data.size() < 3) {
+        stats->corrupt++;
+        return;
+    }
+    uint16_t crc = 0xFFFF;
+    for (size_t i = 0; i < data.size() - 2; i++) {
+        crc = _crc_ccitt_update(crc, data[i]);
+    }
+    uint16_t sent = (uint16_t)(data[data.size() - 2] | (data[data.size() - 1] << 8));
+    if (crc != sent) {
+        stats->corrupt++;
+        return;
+    }
+
+    uint8_t channel = data[0] >> DEBUG_FRAME_SEQ_BITS;
+    uint8_t seq = data[0] & DEBUG_FRAME_SEQ_MASK;
+    if (stats->synced[channel]) {
+        stats->missing += (uint8_t)(seq - stats->nextSeq[channel]) & DEBUG_FRAME_SEQ_MASK;
+    }
+    stats->synced[channel] = true;
+    stats->nextSeq[channel] = (seq + 1) & DEBUG_FRAME_SEQ_MASK;
+    stats->good++;
+    fwrite(&data[1], 1, data.size() - 3, stdout);
+}
+
+int main(int argc, char **argv) {
+    FILE *in = stdin;
+    if (argc > 1) {
+        in = fopen(argv[1], "rb");
+        if (!in) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    deframeStats_t stats;
+    memset(&stats, 0, sizeof(stats));
+    std::vector<uint8_t> frame;
+    bool first = true;
+    int c;
+    while ((c = fgetc(in)) != EOF) {
+        if (c != 0) {
+            frame.push_back((uint8_t)c);
+            continue;
+        }
+        // Bytes before the first delimiter may be the tail of a frame already in flight
+        if (!frame.empty() && !first) {
+            deframe_frame(frame, &stats);
+            fflush(stdout);
+        }
+        frame.clear();
+        first = false;
+    }
+    if (!frame.empty()) {
+        stats.corrupt++;    // Capture ended inside a frame
+    }
+
+    unsigned long expected = stats.good + stats.missing;
+    fprintf(stderr, "%lu frames, %lu corrupt, %lu missing, %.2f%% loss\n", stats.good,
+            stats.corrupt, stats.missing,
+            expected ? 100.0 * (double)stats.missing / (double)expected : 0.0);
+    return 0;
+}
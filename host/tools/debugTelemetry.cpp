@@ -0,0 +1,175 @@
+/*
+ * debugTelemetry.cpp
+ *
+ * Host converter from debugSerial telemetry records (debugTelemetrySample) to CSV.
+ *
+ * Usage: debugTelemetry [capture] > samples.csv
+ *
+ * Reads the captured TX stream from the capture file or stdin (pipe it through
+ * debugDeframe first for DEBUG_FRAMING builds) and writes one CSV row per sampling
+ * period: "sample,ch0,ch1,...". A row ends when a channel index does not increase,
+ * so the target must sample its channels in ascending order. Channels missing from a
+ * period are left empty, as are delta samples that arrive before the first full
+ * value of their channel. Text, token records and binary timestamps in the stream are
+ * skipped.
+ */
+
+#include "debugSerial.h"
+
+#include <cstdio>
+#include <vector>
+
+typedef struct {
+    std::vector<int32_t> last;      // Running value per channel
+    std::vector<bool> known;        // A full value has been seen since the last begin
+    std::vector<bool> filled;       // Channel has a value in the current row
+    int lastChannel;
+    unsigned long row;
+    bool header;
+} telemetryState_t;
+
+// -----------------------------------------------------------------------------------
+// Table start procedure
+// -----------------------------------------------------------------------------------
+// Input : telemetryState_t *st - Converter state
+// Input : uint8_t channels - Number of columns
+// Output: void
+// Prints the CSV header and forgets all running values.
+// -----------------------------------------------------------------------------------
+static void telemetry_begin(telemetryState_t *st, uint8_t channels) {
+    st->last.assign(channels, 0);
+    st->known.assign(channels, false);
+    st->filled.assign(channels, false);
+    st->lastChannel = -1;
+    st->row = 0;
+    st->header = true;
+    printf("sample");
+    for (uint8_t c = 0; c < channels; c++) {
+        printf(",ch%u", c);
+    }
+    printf("\n");
+}
+
+// -----------------------------------------------------------------------------------
+// Row output procedure
+// -----------------------------------------------------------------------------------
+// Input : telemetryState_t *st - Converter state
+// Output: void
+// Prints the current row, if it holds any value, and starts a new one.
+// -----------------------------------------------------------------------------------
+static void telemetry_flush(telemetryState_t *st) {
+    if (st->lastChannel < 0) {
+        return;
+    }
+    printf("%lu", st->row++);
+    for (size_t c = 0; c < st->filled.size(); c++) {
+        if (st->filled[c]) {
+            printf(",%ld", (long)st->last[c]);
+        } else {
+            printf(",");
+        }
+        st->filled[c] = false;
+    }
+    printf("\n");
+    st->lastChannel = -1;
+}
+
+// -----------------------------------------------------------------------------------
+// Sample procedure
+// -----------------------------------------------------------------------------------
+// Input : telemetryState_t *st - Converter state
+// Input : uint8_t channel - Channel index
+// Input : bool delta - value is a difference to the previous sample
+// Input : int32_t value - Full value or difference
+// Output: void
+// -----------------------------------------------------------------------------------
+static void telemetry_sample(telemetryState_t *st, uint8_t channel, bool delta, int32_t value) {
+    if (!st->header) {
+        telemetry_begin(st, DEBUG_TELEMETRY_CHANNELS);
+    }
+    if (channel >= st->last.size()) {
+        return;
+    }
+    if ((int)channel <= st->lastChannel) {
+        telemetry_flush(st);
+    }
+    if (delta) {
+        if (!st->known[channel]) {
+            return;
+        }
+        value = (int32_t)((uint32_t)st->last[channel] + (uint32_t)value);
+    }
+    st->last[channel] = value;
+    st->known[channel] = true;
+    st->filled[channel] = true;
+    st->lastChannel = channel;
+}
+
+int main(int argc, char **argv) {
+    FILE *in = stdin;
+    if (argc > 1) {
+        in = fopen(argv[1], "rb");
+        if (!in) {
+            perror(argv[1]);
+            return 1;
+        }
+    }
+
+    telemetryState_t st;
+    st.lastChannel = -1;
+    st.row = 0;
+    st.header = false;
+    int c;
+    while ((c = fgetc(in)) != EOF) {
+        if (c == DEBUG_TIMESTAMP_START) {
+            for (int i = 0; i < 4; i++) {
+                fgetc(in);
+            }
+            continue;
+        }
+        if (c == DEBUG_TOKEN_START) {
+            int len = fgetc(in);
+            for (int i = 0; i < len; i++) {
+                fgetc(in);
+            }
+            continue;
+        }
+        if (c != DEBUG_TELEMETRY_START) {
+            continue;
+        }
+        int id = fgetc(in);
+        if (id == EOF) {
+            break;
+        }
+        if (id == DEBUG_TELEMETRY_BEGIN) {
+            int channels = fgetc(in);
+            if (channels == EOF) {
+                break;
+            }
+            telemetry_flush(&st);
+            telemetry_begin(&st, (uint8_t)channels);
+            continue;
+        }
+
+        uint8_t channel = id & ~DEBUG_TELEMETRY_DELTA;
+        if (id & DEBUG_TELEMETRY_DELTA) {
+            uint32_t zigzag = 0;
+            int b;
+            for (uint8_t shift = 0; (b = fgetc(in)) != EOF && shift < 35; shift += 7) {
+                zigzag |= (uint32_t)(b & 0x7F) << shift;
+                if (!(b & 0x80)) {
+                    break;
+                }
+            }
+            telemetry_sample(&st, channel, true, (int32_t)((zigzag >> 1) ^ (0 - (zigzag & 1))));
+        } else {
+            uint32_t value = 0;
+            for (uint8_t i = 0; i < 4; i++) {
+                value |= (uint32_t)(fgetc(in) & 0xFF) << (8 * i);
+            }
+            telemetry_sample(&st, channel, false, (int32_t)value);
+        }
+    }
+    telemetry_flush(&st);
+    return 0;
+}